@@ -0,0 +1,306 @@
+#include "ChunkFile.h"
+
+#include "ChunkedTileMap.h"
+#include "SMemory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef SCAL_PLATFORM_WINDOWS
+#define ChunkFileSeek(file, offset) _fseeki64(file, offset, SEEK_SET)
+#else
+#define ChunkFileSeek(file, offset) fseeko(file, offset, SEEK_SET)
+#endif
+
+constexpr global_var size_t CHUNK_FILE_TILES_SIZE = CHUNK_SIZE * sizeof(TileData);
+
+bool ChunkFileWrite(const char* path, int seed, const ChunkCoord* coords, const TileData* tiles, uint32_t count)
+{
+	ChunkFileWriter writer = {};
+	bool success = ChunkFileBeginWrite(&writer, path, seed, count);
+	success = success && ChunkFileWriteBatch(&writer, coords, tiles, count);
+	return ChunkFileEndWrite(&writer) && success;
+}
+
+bool ChunkFileBeginWrite(ChunkFileWriter* writer, const char* path, int seed, uint32_t chunkCount)
+{
+	SASSERT(writer);
+	SASSERT(path);
+	SASSERT(!writer->Handle);
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		SLOG_ERR("[ ChunkFile ] Could not open %s for writing", path);
+		return false;
+	}
+
+	ChunkFileHeader header = {};
+	header.Magic = CHUNK_FILE_MAGIC;
+	header.Version = CHUNK_FILE_VERSION;
+	header.ChunkDimensions = CHUNK_DIMENSIONS;
+	header.TileDataSize = sizeof(TileData);
+	header.Seed = seed;
+	header.ChunkCount = chunkCount;
+	if (fwrite(&header, sizeof(header), 1, file) != 1)
+	{
+		SLOG_ERR("[ ChunkFile ] Failed writing the header of %s", path);
+		fclose(file);
+		return false;
+	}
+
+	writer->Handle = file;
+	writer->ChunkCount = chunkCount;
+	writer->Written = 0;
+	return true;
+}
+
+bool ChunkFileWriteBatch(ChunkFileWriter* writer, const ChunkCoord* coords, const TileData* tiles, uint32_t count)
+{
+	SASSERT(writer);
+	SASSERT(coords);
+	SASSERT(tiles);
+	SASSERT(writer->Written + count <= writer->ChunkCount);
+	if (!writer->Handle)
+		return false;
+
+	// Coords and tiles are separate blocks, each batch fills its part of both
+	int64_t coordsOffset = (int64_t)sizeof(ChunkFileHeader) + (int64_t)writer->Written * (int64_t)sizeof(ChunkCoord);
+	int64_t tilesOffset = (int64_t)sizeof(ChunkFileHeader)
+		+ (int64_t)writer->ChunkCount * (int64_t)sizeof(ChunkCoord)
+		+ (int64_t)writer->Written * (int64_t)CHUNK_FILE_TILES_SIZE;
+
+	FILE* file = (FILE*)writer->Handle;
+	bool success = ChunkFileSeek(file, coordsOffset) == 0
+		&& fwrite(coords, sizeof(ChunkCoord), count, file) == count
+		&& ChunkFileSeek(file, tilesOffset) == 0
+		&& fwrite(tiles, CHUNK_FILE_TILES_SIZE, count, file) == count;
+	if (!success)
+	{
+		SLOG_ERR("[ ChunkFile ] Failed writing chunks %u - %u", writer->Written, writer->Written + count);
+		return false;
+	}
+
+	writer->Written += count;
+	return true;
+}
+
+bool ChunkFileEndWrite(ChunkFileWriter* writer)
+{
+	SASSERT(writer);
+	if (!writer->Handle)
+		return false;
+
+	bool success = fclose((FILE*)writer->Handle) == 0;
+	writer->Handle = nullptr;
+	if (writer->Written != writer->ChunkCount)
+	{
+		SLOG_ERR("[ ChunkFile ] Only %u of %u chunks were written", writer->Written, writer->ChunkCount);
+		success = false;
+	}
+	return success;
+}
+
+bool ChunkFileOpen(ChunkedTileMap* tilemap, const char* path)
+{
+	SASSERT(tilemap);
+	SASSERT(path);
+	SASSERT(!tilemap->PregenFile.Handle);
+
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	ChunkFileHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1
+		|| header.Magic != CHUNK_FILE_MAGIC
+		|| header.Version != CHUNK_FILE_VERSION
+		|| header.ChunkDimensions != CHUNK_DIMENSIONS
+		|| header.TileDataSize != sizeof(TileData))
+	{
+		SLOG_ERR("[ ChunkFile ] %s is not a compatible chunk file", path);
+		fclose(file);
+		return false;
+	}
+
+	size_t coordsSize = header.ChunkCount * sizeof(ChunkCoord);
+	ChunkCoord* coords = nullptr;
+	if (coordsSize > 0)
+	{
+		coords = (ChunkCoord*)SAlloc(SAllocator::Malloc, coordsSize, MemoryTag::Game);
+		if (fread(coords, sizeof(ChunkCoord), header.ChunkCount, file) != header.ChunkCount)
+		{
+			SLOG_ERR("[ ChunkFile ] %s is truncated", path);
+			SFree(SAllocator::Malloc, coords, coordsSize, MemoryTag::Game);
+			fclose(file);
+			return false;
+		}
+	}
+
+	uint32_t directorySize = tilemap->ChunkDirectory.Size + header.ChunkCount;
+	tilemap->ChunkDirectory.Reserve((uint32_t)((float)directorySize / HASHMAP_LOAD_FACTOR) + 1);
+	for (uint32_t i = 0; i < header.ChunkCount; ++i)
+	{
+		if (!CTileMap::IsChunkInBounds(coords[i]))
+			continue;
+
+		ChunkRecord* record = tilemap->ChunkDirectory.Get(&coords[i]);
+		if (!record)
+		{
+			record = tilemap->ChunkDirectory.InsertKey(&coords[i]);
+			record->SpillSlot = CHUNK_SPILL_NO_SLOT;
+		}
+		record->PregenIndex = i;
+		record->Flags |= CHUNK_RECORD_PREGENERATED;
+	}
+
+	if (coords)
+		SFree(SAllocator::Malloc, coords, coordsSize, MemoryTag::Game);
+
+	tilemap->PregenFile.Handle = file;
+	tilemap->PregenFile.Seed = header.Seed;
+	tilemap->PregenFile.ChunkCount = header.ChunkCount;
+
+	SLOG_INFO("[ ChunkFile ] Opened %s, %u pregenerated chunks, seed %d", path, header.ChunkCount, header.Seed);
+	return true;
+}
+
+void ChunkFileClose(ChunkFile* file)
+{
+	SASSERT(file);
+	if (file->Handle)
+	{
+		fclose((FILE*)file->Handle);
+		file->Handle = nullptr;
+	}
+}
+
+bool ChunkFileReadTiles(const ChunkFile* file, uint32_t index, TileData* tiles)
+{
+	SASSERT(file);
+	SASSERT(tiles);
+	if (!file->Handle || index >= file->ChunkCount)
+		return false;
+
+	int64_t offset = (int64_t)sizeof(ChunkFileHeader)
+		+ (int64_t)file->ChunkCount * (int64_t)sizeof(ChunkCoord)
+		+ (int64_t)index * (int64_t)CHUNK_FILE_TILES_SIZE;
+
+	FILE* handle = (FILE*)file->Handle;
+	if (ChunkFileSeek(handle, offset) != 0
+		|| fread(tiles, CHUNK_FILE_TILES_SIZE, 1, handle) != 1)
+	{
+		SLOG_ERR("[ ChunkFile ] Failed reading pregenerated chunk %u", index);
+		return false;
+	}
+	return true;
+}
+
+uint32_t ChunkSpillWrite(ChunkSpillFile* spill, const TileData* tiles)
+{
+	SASSERT(spill);
+	SASSERT(tiles);
+	if (!spill->Handle)
+	{
+		if (spill->IsUnavailable)
+			return CHUNK_SPILL_NO_SLOT;
+
+		spill->Handle = tmpfile();
+		if (!spill->Handle)
+		{
+			SLOG_WARN("[ ChunkFile ] Could not create the chunk spill file, modified chunks stay in memory");
+			spill->IsUnavailable = true;
+			return CHUNK_SPILL_NO_SLOT;
+		}
+	}
+
+	uint32_t slot;
+	if (spill->FreeSlots.Count > 0)
+		slot = spill->FreeSlots.Memory[--spill->FreeSlots.Count];
+	else
+		slot = spill->SlotCount++;
+
+	FILE* handle = (FILE*)spill->Handle;
+	if (ChunkFileSeek(handle, (int64_t)slot * (int64_t)CHUNK_FILE_TILES_SIZE) != 0
+		|| fwrite(tiles, CHUNK_FILE_TILES_SIZE, 1, handle) != 1)
+	{
+		SLOG_ERR("[ ChunkFile ] Failed spilling chunk tiles to slot %u", slot);
+		spill->FreeSlots.Push(&slot);
+		return CHUNK_SPILL_NO_SLOT;
+	}
+	return slot;
+}
+
+bool ChunkSpillRead(ChunkSpillFile* spill, uint32_t slot, TileData* tiles)
+{
+	SASSERT(spill);
+	SASSERT(tiles);
+	if (!spill->Handle || slot >= spill->SlotCount)
+		return false;
+
+	// Seeking also switches the stream from writing to reading
+	FILE* handle = (FILE*)spill->Handle;
+	bool success = ChunkFileSeek(handle, (int64_t)slot * (int64_t)CHUNK_FILE_TILES_SIZE) == 0
+		&& fread(tiles, CHUNK_FILE_TILES_SIZE, 1, handle) == 1;
+	if (!success)
+		SLOG_ERR("[ ChunkFile ] Failed reading spilled chunk tiles from slot %u", slot);
+
+	spill->FreeSlots.Push(&slot);
+	return success;
+}
+
+void ChunkSpillClose(ChunkSpillFile* spill)
+{
+	SASSERT(spill);
+	if (spill->Handle)
+	{
+		// tmpfile() files are deleted when closed
+		fclose((FILE*)spill->Handle);
+		spill->Handle = nullptr;
+	}
+	spill->FreeSlots.Free();
+	spill->SlotCount = 0;
+}
+
+int TestChunkSpill()
+{
+	constexpr int chunkCount = 3;
+
+	ChunkSpillFile spill = {};
+	TileData* tiles = (TileData*)SAlloc(SAllocator::Malloc, chunkCount * CHUNK_FILE_TILES_SIZE, MemoryTag::Game);
+	TileData* read = (TileData*)SAlloc(SAllocator::Malloc, CHUNK_FILE_TILES_SIZE, MemoryTag::Game);
+	uint8_t* bytes = (uint8_t*)tiles;
+	for (size_t i = 0; i < chunkCount * CHUNK_FILE_TILES_SIZE; ++i)
+		bytes[i] = (uint8_t)(i * 31 + i / CHUNK_FILE_TILES_SIZE);
+
+	uint32_t slots[chunkCount];
+	for (int i = 0; i < chunkCount; ++i)
+		slots[i] = ChunkSpillWrite(&spill, tiles + i * CHUNK_SIZE);
+
+	int passed = 1;
+	if (spill.IsUnavailable)
+	{
+		// Nothing to test without a temporary file, chunks stay in memory
+		SLOG_WARN("[ ChunkFile ] Skipped spill test, no temporary file");
+	}
+	else
+	{
+		// Read back out of order, then a freed slot is reused
+		for (int i = chunkCount - 1; i >= 0; --i)
+		{
+			passed &= ChunkSpillRead(&spill, slots[i], read);
+			passed &= memcmp(read, tiles + i * CHUNK_SIZE, CHUNK_FILE_TILES_SIZE) == 0;
+		}
+		uint32_t reused = ChunkSpillWrite(&spill, tiles + CHUNK_SIZE);
+		passed &= reused < chunkCount && spill.SlotCount == chunkCount;
+		passed &= ChunkSpillRead(&spill, reused, read);
+		passed &= memcmp(read, tiles + CHUNK_SIZE, CHUNK_FILE_TILES_SIZE) == 0;
+		if (!passed)
+			SLOG_ERR("[ ChunkFile ] Spilled chunk tiles did not read back");
+	}
+
+	ChunkSpillClose(&spill);
+	SFree(SAllocator::Malloc, tiles, chunkCount * CHUNK_FILE_TILES_SIZE, MemoryTag::Game);
+	SFree(SAllocator::Malloc, read, CHUNK_FILE_TILES_SIZE, MemoryTag::Game);
+	return passed;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Core.h"
+#include "Vector2i.h"
+
+#include "Structures/SList.h"
+
+struct ChunkedTileMap;
+struct TileData;
+
+// Pregenerated chunks on disk. Layout is a ChunkFileHeader, ChunkCoord[ChunkCount],
+// then CHUNK_SIZE TileData per chunk in the same order as the coords.
+constexpr global_var uint32_t CHUNK_FILE_MAGIC = 0x4B484353; // "SCHK"
+constexpr global_var uint16_t CHUNK_FILE_VERSION = 1;
+
+struct ChunkFileHeader
+{
+	uint32_t Magic;
+	uint16_t Version;
+	uint16_t ChunkDimensions;
+	uint32_t TileDataSize;
+	int Seed;
+	uint32_t ChunkCount;
+};
+
+struct ChunkFile
+{
+	void* Handle;	// FILE*, nullptr if not open
+	int Seed;
+	uint32_t ChunkCount;
+};
+
+// tiles holds CHUNK_SIZE tiles for every coord
+bool ChunkFileWrite(const char* path, int seed, const ChunkCoord* coords, const TileData* tiles, uint32_t count);
+
+// Writes a chunk file in batches, so only a batch of tiles has to be in memory
+struct ChunkFileWriter
+{
+	void* Handle;	// FILE*, nullptr if not open
+	uint32_t ChunkCount;
+	uint32_t Written;
+};
+
+bool ChunkFileBeginWrite(ChunkFileWriter* writer, const char* path, int seed, uint32_t chunkCount);
+// The next count chunks, tiles holds CHUNK_SIZE tiles for every coord
+bool ChunkFileWriteBatch(ChunkFileWriter* writer, const ChunkCoord* coords, const TileData* tiles, uint32_t count);
+// Closes the file, fails if fewer than chunkCount chunks were written
+bool ChunkFileEndWrite(ChunkFileWriter* writer);
+
+// Opens tilemap->PregenFile and adds its chunks to the chunk directory.
+// Tiles stay on disk until their chunk is loaded.
+bool ChunkFileOpen(ChunkedTileMap* tilemap, const char* path);
+void ChunkFileClose(ChunkFile* file);
+
+bool ChunkFileReadTiles(const ChunkFile* file, uint32_t index, TileData* tiles);
+
+constexpr global_var uint32_t CHUNK_SPILL_NO_SLOT = UINT32_MAX;
+
+// Tiles of modified chunks that unloaded, kept in an anonymous temporary file
+// so tile memory stays proportional to the loaded chunks. Opened on the first
+// write, slots are reused once their chunk loads again.
+struct ChunkSpillFile
+{
+	void* Handle;			// FILE*, nullptr until the first write
+	SList<uint32_t> FreeSlots;
+	uint32_t SlotCount;
+	bool IsUnavailable;		// Creating the file failed, callers keep tiles in memory
+};
+
+// Returns the slot written to, CHUNK_SPILL_NO_SLOT if writing failed
+uint32_t ChunkSpillWrite(ChunkSpillFile* spill, const TileData* tiles);
+// Reads CHUNK_SIZE tiles and frees the slot
+bool ChunkSpillRead(ChunkSpillFile* spill, uint32_t slot, TileData* tiles);
+void ChunkSpillClose(ChunkSpillFile* spill);
+
+int TestChunkSpill();
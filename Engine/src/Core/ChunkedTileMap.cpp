@@ -5,11 +5,14 @@
 #include "SUtil.h"
 #include "Vector2i.h"
 #include "Renderer.h"
+#include "WickedEngine/Jobs.h"
 
 #include "Structures/SLinkedList.h"
 
 #include "raylib/src/raymath.h"
 
+#include <algorithm>
+
 namespace CTileMap
 {
 
@@ -30,23 +33,32 @@ void Initialize(ChunkedTileMap* tilemap)
 	tilemap->ViewDistance.x = VIEW_DISTANCE;
 	tilemap->ViewDistance.y = VIEW_DISTANCE;
 
-	tilemap->WorldDimChunks = { 4, 4 };
-
-	tilemap->WorldDimTiles.x = tilemap->WorldDimChunks.x * CHUNK_DIMENSIONS;
-	tilemap->WorldDimTiles.y = tilemap->WorldDimChunks.y * CHUNK_DIMENSIONS;
-
 	SASSERT(tilemap->ViewDistance.x > 0);
 	SASSERT(tilemap->ViewDistance.y > 0);
 	constexpr uint32_t capacity = 5 * 5 * 2;
 	static_assert(capacity > 0, "capactiy > 0");
 	tilemap->Chunks.Reserve(capacity);
+	tilemap->ChunkDirectory.Reserve(capacity);
 }
 
 void Free(ChunkedTileMap* tilemap)
 {
 	SASSERT(tilemap->Chunks.IsAllocated());
 
+	for (uint32_t i = 0; i < tilemap->ChunkDirectory.Capacity; ++i)
+	{
+		ChunkRecord* record = tilemap->ChunkDirectory.Index(i);
+		if (record && record->PersistedTiles)
+		{
+			SFree(SAllocator::Game, record->PersistedTiles, CHUNK_SIZE * sizeof(TileData), MemoryTag::Game);
+		}
+	}
+
+	ChunkFileClose(&tilemap->PregenFile);
+	ChunkSpillClose(&tilemap->SpillFile);
+
 	tilemap->Chunks.Free();
+	tilemap->ChunkDirectory.Free();
 	tilemap->ChunksToUnload.Free();
 }
 
@@ -60,6 +72,10 @@ void Update(ChunkedTileMap* tilemap, Game* game)
 	SASSERT(tilemap);
 	SASSERT(game);
 
+	JournalDispatch(tilemap);
+
+	tilemap->SimTime += GetDeltaTime();
+
 	const SEntity* player = GetClientPlayer();
 
 	//Vector2 playerPos = player->AsPosition();
@@ -68,14 +84,8 @@ void Update(ChunkedTileMap* tilemap, Game* game)
 	// View distance checks + chunk loading
 	Vector2i start = playerChunkPos.Subtract(tilemap->ViewDistance);
 	Vector2i end = playerChunkPos.Add(tilemap->ViewDistance);
-	for (int chunkY = start.y; chunkY <= end.y; ++chunkY)
-	{
-		for (int chunkX = start.x; chunkX <= end.x; ++chunkX)
-		{
-			LoadChunk(tilemap, { chunkX, chunkY });
-		}
-	}
-	
+	LoadChunks(tilemap, start, end);
+
 	for (uint32_t i = 0; i < tilemap->Chunks.Capacity; ++i)
 	{
 		if (tilemap->Chunks.Buckets[i].Occupied)
@@ -99,7 +109,7 @@ void Update(ChunkedTileMap* tilemap, Game* game)
 				// Chunk Update
 				if (FlagTrue(chunk->RebakeFlags, CHUNK_REBAKE_SELF))
 				{
-					BakeChunkLighting(tilemap, chunk, FlagTrue(chunk->RebakeFlags, CHUNK_REBAKE_NEIGHBORS));
+					BakeChunkLighting(tilemap, chunk, chunk->RebakeFlags);
 				}
 
 				chunk->TileUpdater.Update(tilemap, chunk, GetDeltaTime());
@@ -141,9 +151,14 @@ void LateUpdate(ChunkedTileMap* tilemap, Game* game)
 	}
 }
 
-TileMapChunk* LoadChunk(ChunkedTileMap* tilemap, ChunkCoord coord)
+// Allocates and restores the chunk. needsGeneration is set if
+// the tiles still have to be generated before FinishLoadChunk().
+internal TileMapChunk*
+BeginLoadChunk(ChunkedTileMap* tilemap, ChunkCoord coord, bool* needsGeneration)
 {
-	if (!IsChunkInBounds(tilemap, coord))
+	*needsGeneration = false;
+
+	if (!IsChunkInBounds(coord))
 		return nullptr;
 
 	if (IsChunkLoaded(tilemap, coord))
@@ -168,30 +183,142 @@ TileMapChunk* LoadChunk(ChunkedTileMap* tilemap, ChunkCoord coord)
 
 	chunk->RebakeFlags = CHUNK_REBAKE_ALL;
 
-	MapGenGenerateChunk(&GetGame()->MapGen, tilemap, chunk);
+	ChunkRecord* record = tilemap->ChunkDirectory.Get(&coord);
+	if (!record)
+	{
+		record = tilemap->ChunkDirectory.InsertKey(&coord);
+		record->SpillSlot = CHUNK_SPILL_NO_SLOT;
+	}
+
+	// Chunk was modified before unloading, restore it instead of generating
+	bool isRestored = false;
+	if (record->PersistedTiles)
+	{
+		SMemCopy(chunk->Tiles.Data, record->PersistedTiles, chunk->Tiles.MemorySize());
+		SFree(SAllocator::Game, record->PersistedTiles, CHUNK_SIZE * sizeof(TileData), MemoryTag::Game);
+		record->PersistedTiles = nullptr;
+		isRestored = true;
+	}
+	else if (record->SpillSlot != CHUNK_SPILL_NO_SLOT)
+	{
+		isRestored = ChunkSpillRead(&tilemap->SpillFile, record->SpillSlot, chunk->Tiles.Data);
+		record->SpillSlot = CHUNK_SPILL_NO_SLOT;
+	}
 
-	int idx = 0;
-	for (int y = 0; y < CHUNK_DIMENSIONS; ++y)
+	if (isRestored)
 	{
-		for (int x = 0; x < CHUNK_DIMENSIONS; ++x)
-		{
-			float worldX = (float)x + (float)chunk->ChunkCoord.x * (float)CHUNK_DIMENSIONS;
-			float worldY = (float)y + (float)chunk->ChunkCoord.y * (float)CHUNK_DIMENSIONS;
+		record->Flags &= ~CHUNK_RECORD_PERSISTED;
+		chunk->IsModified = true;
+	}
+	else if (!FlagTrue(record->Flags, CHUNK_RECORD_PREGENERATED)
+		|| !ChunkFileReadTiles(&tilemap->PregenFile, record->PregenIndex, chunk->Tiles.Data))
+	{
+		*needsGeneration = true;
+	}
+
+	return chunk;
+}
+
+internal void
+NotifyChunkChange(ChunkedTileMap* tilemap, ChunkCoord coord, bool loaded)
+{
+	for (int i = 0; i < CHUNK_MAX_SUBSCRIBERS; ++i)
+	{
+		ChunkSubscriber* subscriber = &tilemap->ChunkSubscribers[i];
+		if (subscriber->Callback)
+			subscriber->Callback(coord, loaded, subscriber->UserData);
+	}
+}
 
-			Vector2i coord = { (int)worldX, (int)worldY };
-			TileData* data = &chunk->Tiles[idx];
-			Tile* tile = data->GetTile();
+internal void
+FinishLoadChunk(ChunkedTileMap* tilemap, TileMapChunk* chunk)
+{
+	ChunkCoord coord = chunk->ChunkCoord;
+	ChunkRecord* record = tilemap->ChunkDirectory.Get(&coord);
+	SASSERT(record);
 
-			++idx;
+	// Chunk was loaded before, fast forward time it was dormant
+	if (FlagTrue(record->Flags, CHUNK_RECORD_GENERATED))
+	{
+		chunk->TileUpdater.Index = record->UpdaterIndex;
+		double dormantTime = tilemap->SimTime - record->DormantTime;
+		int changed = chunk->TileUpdater.CatchUp(tilemap, chunk, dormantTime);
+		if (changed > 0)
+		{
+			chunk->IsModified = true;
+			SLOG_INFO("[ Chunk ] Catch up changed %d tiles in chunk (%s), dormant for %.1fs",
+				changed, FMT_VEC2I(coord), dormantTime);
 		}
 	}
+	record->Flags |= CHUNK_RECORD_GENERATED;
+
+	BuildSolidMasks(chunk);
 
 	chunk->State = ChunkState::Loaded;
+	++tilemap->ChunksVersion;
+	NotifyChunkChange(tilemap, coord, true);
 
 	SLOG_INFO("[ Chunk ] Loaded chunk (%s). State: %s", FMT_VEC2I(coord), ChunkStateToString(chunk->State));
+}
+
+TileMapChunk* LoadChunk(ChunkedTileMap* tilemap, ChunkCoord coord)
+{
+	bool needsGeneration;
+	TileMapChunk* chunk = BeginLoadChunk(tilemap, coord, &needsGeneration);
+	if (!chunk)
+		return nullptr;
+
+	if (needsGeneration)
+		MapGenGenerateChunk(&GetGame()->MapGen, tilemap, chunk);
+
+	FinishLoadChunk(tilemap, chunk);
 	return chunk;
 }
 
+void LoadChunks(ChunkedTileMap* tilemap, ChunkCoord start, ChunkCoord end)
+{
+	SList<TileMapChunk*> loaded = {};
+	loaded.Allocator = SAllocator::Temp;
+	SList<TileMapChunk*> toGenerate = {};
+	toGenerate.Allocator = SAllocator::Temp;
+
+	for (int chunkY = start.y; chunkY <= end.y; ++chunkY)
+	{
+		for (int chunkX = start.x; chunkX <= end.x; ++chunkX)
+		{
+			bool needsGeneration;
+			TileMapChunk* chunk = BeginLoadChunk(tilemap, { chunkX, chunkY }, &needsGeneration);
+			if (!chunk)
+				continue;
+
+			loaded.Push(&chunk);
+			if (needsGeneration)
+				toGenerate.Push(&chunk);
+		}
+	}
+
+	if (toGenerate.Count > 0)
+	{
+		// Climate regions are inserted into a hashmap, generation only reads them
+		MapGenerator* generator = &GetGame()->MapGen;
+		MapGenPrewarmRegions(generator, start, end);
+
+		TileMapChunk** chunks = toGenerate.Memory;
+		wi::jobsystem::context ctx;
+		wi::jobsystem::Dispatch(ctx, toGenerate.Count, 1, [generator, tilemap, chunks](wi::jobsystem::JobArgs args)
+			{
+				MapGenGenerateChunk(generator, tilemap, chunks[args.jobIndex]);
+			});
+		wi::jobsystem::Wait(ctx);
+	}
+
+	for (uint32_t i = 0; i < loaded.Count; ++i)
+	{
+		FinishLoadChunk(tilemap, loaded[i]);
+	}
+}
+
+
 void UnloadChunk(ChunkedTileMap* tilemap, ChunkCoord coord)
 {
 	TileMapChunk** chunkPtr = tilemap->Chunks.Get(&coord);
@@ -200,9 +327,28 @@ void UnloadChunk(ChunkedTileMap* tilemap, ChunkCoord coord)
 		TileMapChunk* chunk = *chunkPtr;
 		SASSERT(chunk);
 
+		ChunkRecord* record = tilemap->ChunkDirectory.Get(&coord);
+		SASSERT(record);
+		record->DormantTime = tilemap->SimTime;
+		record->UpdaterIndex = chunk->TileUpdater.Index;
+
+		if (chunk->IsModified)
+		{
+			SASSERT(!record->PersistedTiles && record->SpillSlot == CHUNK_SPILL_NO_SLOT);
+			record->SpillSlot = ChunkSpillWrite(&tilemap->SpillFile, chunk->Tiles.Data);
+			if (record->SpillSlot == CHUNK_SPILL_NO_SLOT)
+			{
+				record->PersistedTiles = (TileData*)SAlloc(SAllocator::Game, CHUNK_SIZE * sizeof(TileData), MemoryTag::Game);
+				SMemCopy(record->PersistedTiles, chunk->Tiles.Data, chunk->Tiles.MemorySize());
+			}
+			record->Flags |= CHUNK_RECORD_PERSISTED;
+		}
+
 		tilemap->Chunks.Remove(&coord);
+		++tilemap->ChunksVersion;
 
 		SFree(SAllocator::Game, chunk, sizeof(TileMapChunk), MemoryTag::Game);
+		NotifyChunkChange(tilemap, coord, false);
 
 		SLOG_INFO("[ Chunk ] Unloaded chunk (%s)", FMT_VEC2I(coord));
 	}
@@ -238,9 +384,7 @@ void BakeChunkLighting(ChunkedTileMap* tilemap, TileMapChunk* chunk, int chunkBa
 			{
 				Vector2i coord = chunk->StartTile + Vector2i{ x, y };
 				TileData* data = &chunk->Tiles[idx];
-				Tile* tile = data->GetTile();
-
-				if (tile->EmitsLight)
+				if (data->EmitsLight())
 				{
 					StaticLight light;
 					light.Color = RED;
@@ -269,7 +413,7 @@ void BakeChunkLighting(ChunkedTileMap* tilemap, TileMapChunk* chunk, int chunkBa
 		{
 			if (FlagTrue(chunkBakeFlags, CHUNK_REBAKE_NEIGHBORS))
 			{
-				neighborChunk->RebakeFlags = CHUNK_REBAKE_SELF;
+				neighborChunk->RebakeFlags |= CHUNK_REBAKE_SELF;
 			}
 
 			int idx = 0;
@@ -279,9 +423,7 @@ void BakeChunkLighting(ChunkedTileMap* tilemap, TileMapChunk* chunk, int chunkBa
 				{
 					Vector2i coord = neighborChunk->StartTile + Vector2i{ x, y };
 					TileData* data = &neighborChunk->Tiles[idx];
-					Tile* tile = data->GetTile();
-
-					if (tile->EmitsLight)
+					if (data->EmitsLight())
 					{
 						StaticLight light;
 						light.Color = RED;
@@ -316,20 +458,19 @@ bool IsChunkLoaded(ChunkedTileMap* tilemap,
 	return (tilemap->Chunks.Get(&coord));
 }
 
-bool IsTileInBounds(ChunkedTileMap* tilemap, TileCoord tilePos)
+// NOTE: Bounds are only the limits of chunk coordinates. These are checked
+// when loading chunks, per tile access only needs to check if a chunk is loaded.
+bool IsTileInBounds(TileCoord tilePos)
 {
-	return (tilePos.x >= -tilemap->WorldDimTiles.x
-		&& tilePos.y >= -tilemap->WorldDimTiles.y
-		&& tilePos.x < tilemap->WorldDimTiles.x
-		&& tilePos.y < tilemap->WorldDimTiles.y);
+	return IsChunkInBounds(TileToChunkCoord(tilePos));
 }
 
-bool IsChunkInBounds(ChunkedTileMap* tilemap, ChunkCoord chunkPos)
+bool IsChunkInBounds(ChunkCoord chunkPos)
 {
-	return (chunkPos.x >= -tilemap->WorldDimChunks.x
-		&& chunkPos.y >= -tilemap->WorldDimChunks.y
-		&& chunkPos.x < tilemap->WorldDimChunks.x
-		&& chunkPos.y < tilemap->WorldDimChunks.y);
+	return (chunkPos.x >= -CHUNK_COORD_LIMIT
+		&& chunkPos.y >= -CHUNK_COORD_LIMIT
+		&& chunkPos.x < CHUNK_COORD_LIMIT
+		&& chunkPos.y < CHUNK_COORD_LIMIT);
 }
 
 TileMapChunk* 
@@ -349,17 +490,19 @@ GetChunkByTile(ChunkedTileMap* tilemap, TileCoord tileCoord)
 ChunkCoord 
 TileToChunkCoord(TileCoord tilePos)
 {
+	// Arithmetic shift floors negative coordinates, floats would
+	// lose precision far away from the origin.
 	ChunkCoord result;
-	result.x = (int)floorf((float)tilePos.x / (float)CHUNK_DIMENSIONS);
-	result.y = (int)floorf((float)tilePos.y / (float)CHUNK_DIMENSIONS);
+	result.x = tilePos.x >> CHUNK_DIMENSIONS_SHIFT;
+	result.y = tilePos.y >> CHUNK_DIMENSIONS_SHIFT;
 	return result;
 }
 
 size_t 
 GetTileLocalIndex(TileCoord tilePos)
 {
-	int tileChunkX = IModNegative(tilePos.x, CHUNK_DIMENSIONS);
-	int tileChunkY = IModNegative(tilePos.y, CHUNK_DIMENSIONS);
+	int tileChunkX = tilePos.x & CHUNK_DIMENSIONS_MASK;
+	int tileChunkY = tilePos.y & CHUNK_DIMENSIONS_MASK;
 	size_t result = (size_t)tileChunkX + (size_t)tileChunkY * CHUNK_DIMENSIONS;
 	SASSERT(result < CHUNK_SIZE);
 	return result;
@@ -370,7 +513,6 @@ SetTile(ChunkedTileMap* tilemap, const TileData* tile, TileCoord tilePos)
 {
 	SASSERT(tilemap);
 	SASSERT(tile);
-	SASSERT(IsTileInBounds(tilemap, tilePos));
 
 	ChunkCoord chunkCoord = TileToChunkCoord(tilePos);
 	TileMapChunk* chunk = GetChunk(tilemap, chunkCoord);
@@ -385,7 +527,101 @@ SetTile(ChunkedTileMap* tilemap, const TileData* tile, TileCoord tilePos)
 		return;
 	}
 	uint64_t index = GetTileLocalIndex(tilePos);
+	if (chunk->Tiles[index].EmitsLight() || tile->EmitsLight())
+		chunk->RebakeFlags |= CHUNK_REBAKE_ALL;
+
+	JournalRecord(tilemap, tilePos, chunk->Tiles[index], *tile);
 	chunk->Tiles[index] = *tile;
+	SetSolidMask(chunk, index, tile->IsSolid());
+	chunk->IsModified = true;
+}
+
+uint32_t
+ApplyEditBatch(ChunkedTileMap* tilemap, TileEditBatch* batch)
+{
+	SASSERT(tilemap);
+	SASSERT(batch);
+
+	SList<TileEdit>* edits = &batch->Edits;
+	if (edits->Count == 0)
+		return 0;
+
+	std::sort(edits->Memory, edits->Memory + edits->Count, [](const TileEdit& a, const TileEdit& b)
+		{
+			if (a.Chunk.y != b.Chunk.y) return a.Chunk.y < b.Chunk.y;
+			if (a.Chunk.x != b.Chunk.x) return a.Chunk.x < b.Chunk.x;
+			if (a.LocalIndex != b.LocalIndex) return a.LocalIndex < b.LocalIndex;
+			return a.Order < b.Order;
+		});
+
+	// Chunks with light emitting tiles added or removed
+	SList<TileMapChunk*> relight = {};
+	relight.Allocator = SAllocator::Temp;
+
+	uint32_t applied = 0;
+	uint32_t i = 0;
+	while (i < edits->Count)
+	{
+		ChunkCoord chunkCoord = edits->Memory[i].Chunk;
+		TileMapChunk* chunk = GetChunk(tilemap, chunkCoord);
+		if (chunk && chunk->State == ChunkState::Unloaded)
+			chunk = nullptr;
+
+		if (!chunk)
+			SLOG_WARN("[ Tilemap ] Edit batch dropped edits, nonexistent chunk(%s)", FMT_VEC2I(chunkCoord));
+
+		bool lightChanged = false;
+		for (; i < edits->Count && edits->Memory[i].Chunk == chunkCoord; ++i)
+		{
+			if (!chunk)
+				continue;
+
+			const TileEdit* edit = &edits->Memory[i];
+			TileData* dst = &chunk->Tiles[edit->LocalIndex];
+			lightChanged |= dst->EmitsLight() || edit->Tile.EmitsLight();
+
+			JournalRecord(tilemap, edit->Coord, *dst, edit->Tile);
+			*dst = edit->Tile;
+			SetSolidMask(chunk, edit->LocalIndex, dst->IsSolid());
+			++applied;
+		}
+
+		if (chunk)
+			chunk->IsModified = true;
+		if (lightChanged)
+			relight.Push(&chunk);
+	}
+
+	// Each changed chunk is baked once here, neighbors get marked so
+	// they bake once in Update(). Chunks with a pending bake are left to it.
+	for (uint32_t chunkIdx = 0; chunkIdx < relight.Count; ++chunkIdx)
+	{
+		TileMapChunk* chunk = relight.Memory[chunkIdx];
+		if (!FlagTrue(chunk->RebakeFlags, CHUNK_REBAKE_SELF))
+			BakeChunkLighting(tilemap, chunk, 0);
+
+		for (int n = 0; n < ArrayLength(Vec2i_NEIGHTBORS_CORNERS); ++n)
+		{
+			TileMapChunk* neighbor = GetChunk(tilemap, chunk->ChunkCoord + Vec2i_NEIGHTBORS_CORNERS[n]);
+			if (!neighbor)
+				continue;
+
+			bool isRelit = false;
+			for (uint32_t j = 0; j < relight.Count; ++j)
+			{
+				if (relight.Memory[j] == neighbor)
+				{
+					isRelit = true;
+					break;
+				}
+			}
+			if (!isRelit)
+				neighbor->RebakeFlags |= CHUNK_REBAKE_SELF;
+		}
+	}
+
+	edits->Count = 0;
+	return applied;
 }
 
 TileData* 
@@ -393,7 +629,6 @@ GetTile(ChunkedTileMap* tilemap, TileCoord tilePos)
 {
 	SASSERT(tilemap);
 	SASSERT(tilemap->Chunks.IsAllocated());
-	SASSERT(IsTileInBounds(tilemap, tilePos));
 
 	ChunkCoord chunkCoord = TileToChunkCoord(tilePos);
 	TileMapChunk* chunk = GetChunk(tilemap, chunkCoord);
@@ -421,7 +656,6 @@ TileCoord WorldToTile(Vector2 pos)
 // unused.
 void SetVisible(ChunkedTileMap* tilemap, TileCoord coord)
 {
-	if (!IsTileInBounds(tilemap, coord)) return;
 	Vector2i cullTile = WorldTileToCullTile(coord);
 	int index = cullTile.x + cullTile.y * GetGameApp()->View.ResolutionInTiles.x;
 	//GetGame()->TileMapRenderer.Tiles[index].LOS = true;
@@ -432,55 +666,154 @@ void SetVisible(ChunkedTileMap* tilemap, TileCoord coord)
 
 bool BlocksLight(ChunkedTileMap* tilemap, TileCoord coord)
 {
-	if (!IsTileInBounds(tilemap, coord)) return true;
-	TileData* tileData = GetTile(tilemap, coord);
-	SASSERT(tileData);
-	return tileData->GetTile()->Type == TileType::Solid;
+	// Tiles in unloaded chunks block light
+	TileMapChunk* chunk = GetChunkByTile(tilemap, coord);
+	if (!chunk) return true;
+	TileData* tileData = &chunk->Tiles[GetTileLocalIndex(coord)];
+	return tileData->IsSolid();
 }
 
-internal void
-UpdateTileMap(ChunkedTileMap* tilemap, TileMapRenderer* tilemapRenderer)
+void BuildSolidMasks(TileMapChunk* chunk)
 {
-	LightingRenderer* lightRenderer = &GetGame()->LightingRenderer;
+	SMemClear(chunk->SolidColumns, sizeof(chunk->SolidColumns));
+	for (int y = 0; y < CHUNK_DIMENSIONS; ++y)
+	{
+		uint64_t row = 0;
+		for (int x = 0; x < CHUNK_DIMENSIONS; ++x)
+		{
+			uint64_t solid = (uint64_t)chunk->Tiles[x + y * CHUNK_DIMENSIONS].IsSolid();
+			row |= solid << x;
+			chunk->SolidColumns[x] |= solid << y;
+		}
+		chunk->SolidRows[y] = row;
+	}
+}
 
-	size_t idx = 0;
-	for (int y = 0; y < GetGameApp()->View.ResolutionInTiles.y; ++y)
+int JournalSubscribe(ChunkedTileMap* tilemap, TileChangeCallback callback, void* userData)
+{
+	SASSERT(callback);
+	for (int i = 0; i < TILE_JOURNAL_MAX_SUBSCRIBERS; ++i)
 	{
-		for (int x = 0; x < GetGameApp()->View.ResolutionInTiles.x; ++x)
+		TileJournalSubscriber* subscriber = &tilemap->Journal.Subscribers[i];
+		if (!subscriber->Callback)
 		{
-			Vector2i coord = CullTileToWorldTile({ x, y });
+			subscriber->Callback = callback;
+			subscriber->UserData = userData;
+			return i;
+		}
+	}
+	SLOG_ERR("[ Tilemap ] Journal has no free subscriber slots!");
+	return -1;
+}
 
-			if (IsTileInBounds(tilemap, coord))
-			{
-				TileMapChunk* chunk = GetChunkByTile(tilemap, coord);
-				SASSERT(chunk);
+void JournalUnsubscribe(ChunkedTileMap* tilemap, int handle)
+{
+	SASSERT(handle >= 0 && handle < TILE_JOURNAL_MAX_SUBSCRIBERS);
+	tilemap->Journal.Subscribers[handle] = {};
+}
 
-				size_t localIdx = GetTileLocalIndex(coord);
+int ChunkSubscribe(ChunkedTileMap* tilemap, ChunkChangeCallback callback, void* userData)
+{
+	SASSERT(callback);
+	for (int i = 0; i < CHUNK_MAX_SUBSCRIBERS; ++i)
+	{
+		ChunkSubscriber* subscriber = &tilemap->ChunkSubscribers[i];
+		if (!subscriber->Callback)
+		{
+			subscriber->Callback = callback;
+			subscriber->UserData = userData;
+			return i;
+		}
+	}
+	SLOG_ERR("[ Tilemap ] No free chunk subscriber slots!");
+	return -1;
+}
 
-				TileData* tileData = &chunk->Tiles[localIdx];
-				Color* tileColor = &chunk->TileColors[localIdx];
+void ChunkUnsubscribe(ChunkedTileMap* tilemap, int handle)
+{
+	SASSERT(handle >= 0 && handle < CHUNK_MAX_SUBSCRIBERS);
+	tilemap->ChunkSubscribers[handle] = {};
+}
 
-				tilemapRenderer->Tiles[idx].x = tileData->TexX;
-				tilemapRenderer->Tiles[idx].y = tileData->TexY;
+void JournalDispatch(ChunkedTileMap* tilemap)
+{
+	TileJournal* journal = &tilemap->Journal;
+	uint64_t count = journal->Stamp - journal->DispatchedStamp;
+	if (count == 0)
+		return;
 
-				lightRenderer->TileData[idx].g = (uint8_t)tileData->HasCeiling;
-				//TileLighDataCeilingSet(lightRenderer->TileData[idx], (uint8_t)tileData->HasCeiling);
+	bool overflowed = count > TILE_JOURNAL_CAPACITY;
+	uint32_t start = (uint32_t)(journal->DispatchedStamp & (TILE_JOURNAL_CAPACITY - 1));
+	uint32_t firstCount = (start + count > TILE_JOURNAL_CAPACITY) ? TILE_JOURNAL_CAPACITY - start : (uint32_t)count;
+	uint32_t secondCount = (uint32_t)count - firstCount;
 
-				SMemCopy(&lightRenderer->TileColors[idx], tileColor, sizeof(Color));
+	for (int i = 0; i < TILE_JOURNAL_MAX_SUBSCRIBERS; ++i)
+	{
+		TileJournalSubscriber* subscriber = &journal->Subscribers[i];
+		if (!subscriber->Callback)
+			continue;
 
-				// See SetVisible()
-				if (GetGame()->DebugDisableDarkess)
-					lightRenderer->TileData[idx].r = 1;
-			}
-			else
+		if (overflowed)
+		{
+			subscriber->Callback(nullptr, 0, true, subscriber->UserData);
+			continue;
+		}
+
+		subscriber->Callback(&journal->Changes[start], firstCount, false, subscriber->UserData);
+		if (secondCount > 0)
+			subscriber->Callback(&journal->Changes[0], secondCount, false, subscriber->UserData);
+	}
+
+	journal->DispatchedStamp = journal->Stamp;
+}
+
+internal void
+UpdateTileMap(ChunkedTileMap* tilemap, TileMapRenderer* tilemapRenderer)
+{
+	LightingRenderer* lightRenderer = &GetGame()->LightingRenderer;
+	bool disableDarkness = GetGame()->DebugDisableDarkess;
+
+	Vector2i resolution = GetGameApp()->View.ResolutionInTiles;
+	Vector2i start = CullTileToWorldTile({ 0, 0 });
+	Vector2i end = start + resolution;
+
+	// Tiles in unloaded chunks are not visited
+	SMemSet(tilemapRenderer->Tiles.Memory, 0, tilemapRenderer->Tiles.SizeOf());
+
+	ForEachSpanRect(tilemap, start, end, [&](const TileSpan& span)
+		{
+			size_t idx = (span.Start.x - start.x) + (span.Start.y - start.y) * resolution.x;
+
+			SMemCopy(&lightRenderer->TileColors[idx], span.Colors, span.Count * sizeof(Color));
+
+			for (int i = 0; i < span.Count; ++i)
 			{
-				SMemSet(&tilemapRenderer->Tiles[idx], 0, sizeof(TileData));
-				//SMemSet(&GetGame()->LightingRenderer.Tiles[idx], 0, sizeof(Color));
+				const TileData* tileData = &span.Tiles[i];
+				tilemapRenderer->Tiles[idx + i].x = tileData->TexX;
+				tilemapRenderer->Tiles[idx + i].y = tileData->TexY;
+
+				lightRenderer->TileData[idx + i].g = (uint8_t)tileData->HasCeiling;
+
+				// See SetVisible()
+				if (disableDarkness)
+					lightRenderer->TileData[idx + i].r = 1;
 			}
+		});
+}
 
-			++idx;
-		}
-	}
 }
 
+void TileEditBatch::Add(TileCoord coord, const TileData* tile)
+{
+	SASSERT(tile);
+
+	if (!Edits.Memory)
+		Edits.Allocator = SAllocator::Temp;
+
+	TileEdit* edit = Edits.PushNew();
+	edit->Coord = coord;
+	edit->Chunk = CTileMap::TileToChunkCoord(coord);
+	edit->Tile = *tile;
+	edit->LocalIndex = (uint16_t)CTileMap::GetTileLocalIndex(coord);
+	edit->Order = Edits.Count - 1;
 }
@@ -4,8 +4,10 @@
 #include "Vector2i.h"
 #include "Tile.h"
 #include "Scheduler.h"
+#include "ChunkFile.h"
 
 #include "Structures/SHashMap.h"
+#include "Structures/SList.h"
 #include "Structures/SLinkedList.h"
 #include "Structures/StaticArray.h"
 
@@ -16,6 +18,14 @@ struct Game;
 #define CHUNK_REBAKE_NEIGHBORS (1 << 1)
 #define CHUNK_REBAKE_ALL (CHUNK_REBAKE_SELF | CHUNK_REBAKE_NEIGHBORS)
 
+#define CHUNK_RECORD_GENERATED (1 << 0)
+#define CHUNK_RECORD_PERSISTED (1 << 1)
+#define CHUNK_RECORD_PREGENERATED (1 << 2)
+
+// The world has no fixed size. Chunk coordinates are only limited so
+// tile coordinates, and small offsets from them, fit inside an int.
+constexpr global_var int CHUNK_COORD_LIMIT = 1 << 24;
+
 enum class ChunkState : uint8_t
 {
 	Unloaded = 0,
@@ -34,17 +44,123 @@ struct TileMapChunk
 	ChunkState State;
 	uint8_t RebakeFlags;
 	bool IsBaked;
+	bool IsModified;	// Tiles differ from generation, persisted on unload
 	StaticArray<TileData, CHUNK_SIZE> Tiles;
 	StaticArray<Color, CHUNK_SIZE> TileColors;
+	uint64_t SolidRows[CHUNK_DIMENSIONS];		// Bit x of [y] is set if tile (x, y) is solid
+	uint64_t SolidColumns[CHUNK_DIMENSIONS];	// Bit y of [x] is set if tile (x, y) is solid
+};
+static_assert(CHUNK_DIMENSIONS == 64, "Solid masks store a chunk row in a uint64_t");
+
+// Entry in the chunk directory. Unmodified chunks can always be
+// regenerated from the seed, so only modified chunks keep their tiles,
+// spilled to ChunkedTileMap::SpillFile. Records stay for every chunk
+// generated so dormant chunks can catch up, about 32 bytes each.
+struct ChunkRecord
+{
+	TileData* PersistedTiles;	// CHUNK_SIZE tiles, only if the spill file is unavailable
+	uint32_t SpillSlot;			// Slot in ChunkedTileMap::SpillFile, CHUNK_SPILL_NO_SLOT if none
+	double DormantTime;			// ChunkedTileMap::SimTime when unloaded
+	int UpdaterIndex;
+	uint32_t PregenIndex;		// Chunk index in ChunkedTileMap::PregenFile
+	uint8_t Flags;
+};
+
+// Must be a power of 2
+constexpr global_var uint32_t TILE_JOURNAL_CAPACITY = 4096;
+constexpr global_var int TILE_JOURNAL_MAX_SUBSCRIBERS = 8;
+
+struct TileChange
+{
+	TileCoord Coord;
+	TileData Old;
+	TileData New;
+};
+
+// Called once a frame with every change since the last dispatch. A frame's
+// changes can be split into 2 calls if they wrap around the ring. If overflowed
+// is true changes were lost (changes is nullptr), and the subscriber
+// should rebuild what it caches.
+typedef void(*TileChangeCallback)(const TileChange* changes, uint32_t count, bool overflowed, void* userData);
+
+struct TileJournalSubscriber
+{
+	TileChangeCallback Callback;
+	void* UserData;
+};
+
+// Ring buffer of tile changes made through SetTile. Stamp only
+// increases, caches can store it to later query changes since then.
+struct TileJournal
+{
+	TileChange Changes[TILE_JOURNAL_CAPACITY];
+	TileJournalSubscriber Subscribers[TILE_JOURNAL_MAX_SUBSCRIBERS];
+	uint64_t Stamp;				// Total number of changes recorded
+	uint64_t DispatchedStamp;	// Stamp at last subscriber dispatch
+};
+
+constexpr global_var int CHUNK_MAX_SUBSCRIBERS = 8;
+
+// Called right after a chunk finished loading, or was removed from Chunks
+typedef void(*ChunkChangeCallback)(ChunkCoord coord, bool loaded, void* userData);
+
+struct ChunkSubscriber
+{
+	ChunkChangeCallback Callback;
+	void* UserData;
+};
+
+struct TileEdit
+{
+	TileCoord Coord;
+	ChunkCoord Chunk;
+	TileData Tile;
+	uint16_t LocalIndex;
+	uint32_t Order;		// Later edits to the same tile win
+};
+
+// Accumulates tile edits to apply at once with CTileMap::ApplyEditBatch().
+// Edits are applied in chunk order, and every affected chunk is rebaked once.
+// Uses the temp allocator, apply the batch in the same frame.
+struct TileEditBatch
+{
+	SList<TileEdit> Edits;
+
+	void Add(TileCoord coord, const TileData* tile);
+};
+
+// Contiguous run of tiles in a single chunk row. Tiles and Colors
+// point directly into chunk memory, Start is the world coord of Tiles[0].
+struct TileSpan
+{
+	TileMapChunk* Chunk;
+	TileData* Tiles;
+	Color* Colors;
+	TileCoord Start;
+	int Count;
 };
 
 struct ChunkedTileMap
 {
 	Vector2i ViewDistance;
-	Vector2i WorldDimChunks;	// Used in bounds check
-	Vector2i WorldDimTiles;		// Used in bounds check
-	SHashMap<Vector2i, TileMapChunk*> Chunks;
+	double SimTime;		// Seconds of tile updates simulated
+	uint32_t ChunksVersion;	// Changes whenever a chunk loads or unloads
+	SHashMap<Vector2i, TileMapChunk*> Chunks;			// Loaded chunks
+	SHashMap<Vector2i, ChunkRecord> ChunkDirectory;	// Sparse, every chunk generated or persisted
 	SLinkedList<ChunkCoord> ChunksToUnload;
+	ChunkFile PregenFile;
+	ChunkSpillFile SpillFile;
+	TileJournal Journal;
+	ChunkSubscriber ChunkSubscribers[CHUNK_MAX_SUBSCRIBERS];
+};
+
+// Remembers the last chunk looked up. Shadowcasting mostly walks
+// tiles of one chunk, so most samples skip the Chunks hash lookup.
+struct TileSampler
+{
+	ChunkedTileMap* Tilemap;
+	TileMapChunk* Chunk;	// nullptr if Coord isn't loaded
+	ChunkCoord Coord;
 };
 
 namespace CTileMap
@@ -58,6 +174,8 @@ void Update(ChunkedTileMap* tilemap, Game* game);
 void LateUpdate(ChunkedTileMap* tilemap, Game* game);
 
 TileMapChunk* LoadChunk(ChunkedTileMap* tilemap, ChunkCoord coord);
+// Loads every unloaded chunk in [start, end], generating them in parallel
+void LoadChunks(ChunkedTileMap* tilemap, ChunkCoord start, ChunkCoord end);
 void UnloadChunk(ChunkedTileMap* tilemap, ChunkCoord coord);
 
 void BakeChunkLighting(ChunkedTileMap* tilemap, TileMapChunk* chunk, int chunkBakeFlags);
@@ -72,11 +190,208 @@ TileCoord WorldToTile(Vector2 pos);
 void SetTile(ChunkedTileMap* tilemap, const TileData* tile, TileCoord tilePos);
 TileData* GetTile(ChunkedTileMap* tilemap, TileCoord tilePos);
 
+// Returns number of edits applied. Edits in unloaded chunks are dropped.
+uint32_t ApplyEditBatch(ChunkedTileMap* tilemap, TileEditBatch* batch);
+
 bool IsChunkLoaded(ChunkedTileMap* tilemap, ChunkCoord coord);
-bool IsTileInBounds(ChunkedTileMap* tilemap, TileCoord tilePos);
-bool IsChunkInBounds(ChunkedTileMap* tilemap, ChunkCoord chunkPos);
+bool IsTileInBounds(TileCoord tilePos);
+bool IsChunkInBounds(ChunkCoord chunkPos);
 
 void SetVisible(ChunkedTileMap* tilemap, TileCoord coord);
 bool BlocksLight(ChunkedTileMap* tilemap, TileCoord coord);
 
-}
\ No newline at end of file
+// Rebuilds SolidRows and SolidColumns from every tile
+void BuildSolidMasks(TileMapChunk* chunk);
+
+_FORCE_INLINE_ void SetSolidMask(TileMapChunk* chunk, size_t localIdx, bool solid)
+{
+	size_t x = localIdx & CHUNK_DIMENSIONS_MASK;
+	size_t y = localIdx >> CHUNK_DIMENSIONS_SHIFT;
+	if (solid)
+	{
+		chunk->SolidRows[y] |= 1ull << x;
+		chunk->SolidColumns[x] |= 1ull << y;
+	}
+	else
+	{
+		chunk->SolidRows[y] &= ~(1ull << x);
+		chunk->SolidColumns[x] &= ~(1ull << y);
+	}
+}
+
+// Returns handle used to unsubscribe, or -1 if no free slots
+int JournalSubscribe(ChunkedTileMap* tilemap, TileChangeCallback callback, void* userData);
+void JournalUnsubscribe(ChunkedTileMap* tilemap, int handle);
+void JournalDispatch(ChunkedTileMap* tilemap);
+
+// Returns handle used to unsubscribe, or -1 if no free slots
+int ChunkSubscribe(ChunkedTileMap* tilemap, ChunkChangeCallback callback, void* userData);
+void ChunkUnsubscribe(ChunkedTileMap* tilemap, int handle);
+
+_FORCE_INLINE_ uint64_t JournalStamp(const ChunkedTileMap* tilemap)
+{
+	return tilemap->Journal.Stamp;
+}
+
+_FORCE_INLINE_ void JournalRecord(ChunkedTileMap* tilemap, TileCoord coord, TileData oldTile, TileData newTile)
+{
+	TileChange* change = &tilemap->Journal.Changes[tilemap->Journal.Stamp & (TILE_JOURNAL_CAPACITY - 1)];
+	change->Coord = coord;
+	change->Old = oldTile;
+	change->New = newTile;
+	++tilemap->Journal.Stamp;
+}
+
+// Calls fn(const TileChange&) for every change recorded after stamp.
+// Returns false if changes after stamp have been overwritten.
+template<typename Fn>
+bool JournalForEachSince(const ChunkedTileMap* tilemap, uint64_t stamp, Fn&& fn)
+{
+	const TileJournal* journal = &tilemap->Journal;
+	SASSERT(stamp <= journal->Stamp);
+	if (journal->Stamp - stamp > TILE_JOURNAL_CAPACITY)
+		return false;
+
+	for (uint64_t i = stamp; i < journal->Stamp; ++i)
+	{
+		fn(journal->Changes[i & (TILE_JOURNAL_CAPACITY - 1)]);
+	}
+	return true;
+}
+
+_FORCE_INLINE_ TileSampler CreateTileSampler(ChunkedTileMap* tilemap)
+{
+	// Outside CHUNK_COORD_LIMIT, the first sample always looks up its chunk
+	return { tilemap, nullptr, { INT32_MAX, INT32_MAX } };
+}
+
+_FORCE_INLINE_ TileMapChunk* SampleChunk(TileSampler* sampler, TileCoord coord)
+{
+	ChunkCoord chunkCoord = { coord.x >> CHUNK_DIMENSIONS_SHIFT, coord.y >> CHUNK_DIMENSIONS_SHIFT };
+	if (chunkCoord.x != sampler->Coord.x || chunkCoord.y != sampler->Coord.y)
+	{
+		sampler->Coord = chunkCoord;
+		sampler->Chunk = GetChunk(sampler->Tilemap, chunkCoord);
+	}
+	return sampler->Chunk;
+}
+
+// Same as BlocksLight()
+_FORCE_INLINE_ bool SampleBlocksLight(TileSampler* sampler, TileCoord coord)
+{
+	TileMapChunk* chunk = SampleChunk(sampler, coord);
+	if (!chunk) return true;
+	size_t idx = (size_t)(coord.x & CHUNK_DIMENSIONS_MASK) + (size_t)(coord.y & CHUNK_DIMENSIONS_MASK) * CHUNK_DIMENSIONS;
+	return chunk->Tiles.Data[idx].IsSolid();
+}
+
+// Solid bits of count <= 64 tiles starting at start, walking +x (row) or +y (column).
+// Bit i is tile i along the walk. Tiles in unloaded chunks are solid.
+template<bool Row>
+uint64_t SampleSolidMask(TileSampler* sampler, TileCoord start, int count)
+{
+	SASSERT(count > 0 && count <= 64);
+	uint64_t result = 0;
+	int filled = 0;
+	while (filled < count)
+	{
+		TileCoord coord = (Row) ? TileCoord{ start.x + filled, start.y } : TileCoord{ start.x, start.y + filled };
+		TileMapChunk* chunk = SampleChunk(sampler, coord);
+		int localX = coord.x & CHUNK_DIMENSIONS_MASK;
+		int localY = coord.y & CHUNK_DIMENSIONS_MASK;
+		int offset = (Row) ? localX : localY;
+		int take = CHUNK_DIMENSIONS - offset;
+		if (take > count - filled)
+			take = count - filled;
+
+		uint64_t bits;
+		if (!chunk)
+			bits = ~0ull;
+		else
+			bits = ((Row) ? chunk->SolidRows[localY] : chunk->SolidColumns[localX]) >> offset;
+
+		uint64_t takeMask = (take == 64) ? ~0ull : ((1ull << take) - 1);
+		result |= (bits & takeMask) << filled;
+		filled += take;
+	}
+	return result;
+}
+
+// Region iteration. Walks loaded chunks overlapping the region and calls
+// fn(const TileSpan&) for every row span inside each chunk. Unloaded chunks
+// are skipped. Does not allocate, prefer over GetTile() per tile.
+
+// Visits tiles in [start, end)
+template<typename Fn>
+void ForEachSpanRect(ChunkedTileMap* tilemap, TileCoord start, TileCoord end, Fn&& fn)
+{
+	if (start.x >= end.x || start.y >= end.y) return;
+
+	ChunkCoord startChunk = TileToChunkCoord(start);
+	ChunkCoord endChunk = TileToChunkCoord({ end.x - 1, end.y - 1 });
+	for (int cy = startChunk.y; cy <= endChunk.y; ++cy)
+	{
+		for (int cx = startChunk.x; cx <= endChunk.x; ++cx)
+		{
+			TileMapChunk* chunk = GetChunk(tilemap, { cx, cy });
+			if (!chunk || chunk->State == ChunkState::Unloaded) continue;
+
+			int x0 = (start.x > chunk->StartTile.x) ? start.x : chunk->StartTile.x;
+			int y0 = (start.y > chunk->StartTile.y) ? start.y : chunk->StartTile.y;
+			int x1 = (end.x < chunk->StartTile.x + CHUNK_DIMENSIONS) ? end.x : chunk->StartTile.x + CHUNK_DIMENSIONS;
+			int y1 = (end.y < chunk->StartTile.y + CHUNK_DIMENSIONS) ? end.y : chunk->StartTile.y + CHUNK_DIMENSIONS;
+
+			TileSpan span;
+			span.Chunk = chunk;
+			span.Count = x1 - x0;
+			for (int y = y0; y < y1; ++y)
+			{
+				int localIdx = (x0 - chunk->StartTile.x) + (y - chunk->StartTile.y) * CHUNK_DIMENSIONS;
+				span.Tiles = &chunk->Tiles.Data[localIdx];
+				span.Colors = &chunk->TileColors.Data[localIdx];
+				span.Start = { x0, y };
+				fn(span);
+			}
+		}
+	}
+}
+
+// Visits tiles with a squared distance to center < radius * radius,
+// same as QueryTilesRadius()
+template<typename Fn>
+void ForEachSpanRadius(ChunkedTileMap* tilemap, TileCoord center, float radius, Fn&& fn)
+{
+	if (radius <= 0.0f) return;
+
+	int r = (int)radius;
+	float sqrRadius = radius * radius;
+	TileCoord start = { center.x - r, center.y - r };
+	TileCoord end = { center.x + r + 1, center.y + r + 1 };
+	ForEachSpanRect(tilemap, start, end, [&](const TileSpan& rowSpan)
+		{
+			int dy = rowSpan.Start.y - center.y;
+			float rem = sqrRadius - (float)(dy * dy);
+			if (rem <= 0.0f) return;
+
+			// Largest dx where dx * dx < rem
+			int halfWidth = (int)sqrtf(rem);
+			if ((float)(halfWidth * halfWidth) >= rem) --halfWidth;
+
+			int x0 = center.x - halfWidth;
+			int x1 = center.x + halfWidth + 1;
+			int spanEnd = rowSpan.Start.x + rowSpan.Count;
+			if (x0 < rowSpan.Start.x) x0 = rowSpan.Start.x;
+			if (x1 > spanEnd) x1 = spanEnd;
+			if (x0 >= x1) return;
+
+			TileSpan span = rowSpan;
+			int offset = x0 - rowSpan.Start.x;
+			span.Tiles += offset;
+			span.Colors += offset;
+			span.Start.x = x0;
+			span.Count = x1 - x0;
+			fn(span);
+		});
+}
+
+}
@@ -148,8 +148,11 @@ constexpr global_var float HALF_TILE_SIZE = TILE_SIZE_F / 2.0f;
 constexpr global_var int MAX_TILE_COUNT = ((MAX_WIDTH / TILE_SIZE) + 1) * ((MAX_HEIGHT / TILE_SIZE) + 1);
  
 constexpr global_var int CHUNK_DIMENSIONS = 64;
+constexpr global_var int CHUNK_DIMENSIONS_SHIFT = 6; // log2(CHUNK_DIMENSIONS)
+constexpr global_var int CHUNK_DIMENSIONS_MASK = CHUNK_DIMENSIONS - 1;
 constexpr global_var int CHUNK_SIDE_LENGTH = CHUNK_DIMENSIONS + 1;
 constexpr global_var int CHUNK_SIZE = CHUNK_DIMENSIONS * CHUNK_DIMENSIONS;
+static_assert((1 << CHUNK_DIMENSIONS_SHIFT) == CHUNK_DIMENSIONS, "CHUNK_DIMENSIONS must be a power of 2");
 
 // TODO: move to settings struct?
 constexpr global_var int VIEW_DISTANCE = 2;
@@ -0,0 +1,278 @@
+#include "FieldOfView.h"
+
+#include "ChunkedTileMap.h"
+#include "Lighting.h"
+#include "SUtil.h"
+#include "SRandom.h"
+#include "WickedEngine/Jobs.h"
+
+#include <math.h>
+
+uint32_t FovBatchAdd(FovBatch* batch, const FovViewer* viewer)
+{
+	// Octant columns are 64 bit masks
+	FovViewer* added = batch->Viewers.PushNew();
+	*added = *viewer;
+	if (added->Range == 0 || added->Range > FOV_MAX_RANGE)
+	{
+		SLOG_ERR("[ FOV ] Viewer range %u is outside 1 - %d, clamped", (uint32_t)viewer->Range, FOV_MAX_RANGE);
+		added->Range = (added->Range == 0) ? 1 : (uint8_t)FOV_MAX_RANGE;
+	}
+	viewer = added;
+
+	uint32_t index = batch->Viewers.Count - 1;
+
+	FovVisibility* result = batch->Results.PushNew();
+	result->Origin = viewer->Pos;
+	result->BitsOffset = batch->Bits.Count;
+	result->Range = viewer->Range;
+	result->RowWords = (uint16_t)((viewer->Range * 2 + 1 + 63) / 64);
+	result->VisibleCount = 0;
+
+	// Zeroed, each job only sets bits
+	uint32_t words = (uint32_t)result->RowWords * (viewer->Range * 2 + 1);
+	// Reserve() allocates exactly, double it so a turn of adds isn't quadratic
+	uint32_t bitsCount = batch->Bits.Count + words;
+	if (bitsCount > batch->Bits.Capacity)
+		batch->Bits.Reserve(std::max(bitsCount, batch->Bits.Capacity * 2));
+	batch->Bits.EnsureSize(bitsCount);
+	return index;
+}
+
+// The cone can't see into an octant if the octant's 45 degree
+// wedge is further from LookDir than the cone's half angle
+internal bool
+OctantInCone(uint8_t octant, Vector2 look, float coneAngle)
+{
+	constexpr float halfWedge = PI / 8.0f;
+	if (coneAngle + halfWedge >= PI)
+		return true;
+
+	// Bisector of the octant, (1, tan(22.5)) in octant space
+	const int* t = TranslationTable[octant];
+	constexpr float tanHalfWedge = 0.41421356f;
+	Vector2 bisector = { t[0] + tanHalfWedge * t[1], t[2] + tanHalfWedge * t[3] };
+	float length = sqrtf(bisector.x * bisector.x + bisector.y * bisector.y);
+	float cosAngle = (bisector.x * look.x + bisector.y * look.y) / length;
+	return cosAngle >= cosf(coneAngle + halfWedge);
+}
+
+internal void
+FovComputeViewer(const FovViewer* viewer, FovVisibility* result, uint64_t* bits, ChunkedTileMap* tilemap)
+{
+	int range = result->Range;
+	int rowWords = result->RowWords;
+	Vector2 look = TileDirectionVectors[(uint8_t)viewer->LookDir];
+	bool useCone = viewer->ConeAngle > 0.0f && viewer->ConeAngle < PI;
+	float coneCos = cosf(viewer->ConeAngle);
+
+	TileSampler sampler = CTileMap::CreateTileSampler(tilemap);
+	uint64_t visible[ROW_MASK_FOV_MAX_RADIUS + 1];
+
+	// The viewer's own tile
+	bits[range * rowWords + (range >> 6)] |= 1ull << (range & 63);
+
+	for (uint8_t octant = 0; octant < 8; ++octant)
+	{
+		if (useCone && !OctantInCone(octant, look, viewer->ConeAngle))
+			continue;
+
+		RowMaskComputeOctant(&sampler, viewer->Pos, range, octant, visible);
+
+		const int* t = TranslationTable[octant];
+		for (int x = 1; x <= range; ++x)
+		{
+			uint64_t column = visible[x];
+			if (!column)
+				break;
+
+			while (column)
+			{
+				int y = LowestBitIndex64(column);
+				column &= column - 1;
+
+				int dx = x * t[0] + y * t[1];
+				int dy = x * t[2] + y * t[3];
+				if (useCone)
+				{
+					float dot = (float)dx * look.x + (float)dy * look.y;
+					if (dot < coneCos * sqrtf((float)(dx * dx + dy * dy)))
+						continue;
+				}
+
+				int bx = dx + range;
+				int by = dy + range;
+				bits[by * rowWords + (bx >> 6)] |= 1ull << (bx & 63);
+			}
+		}
+	}
+
+	// Octant edges are shared, count once they are merged
+	uint32_t visibleCount = 0;
+	uint32_t words = (uint32_t)rowWords * (range * 2 + 1);
+	for (uint32_t i = 0; i < words; ++i)
+	{
+		for (uint64_t word = bits[i]; word; word &= word - 1)
+			++visibleCount;
+	}
+	result->VisibleCount = visibleCount;
+}
+
+void FovBatchCompute(FovBatch* batch, ChunkedTileMap* tilemap)
+{
+	if (batch->Viewers.Count == 0)
+		return;
+
+	// Chunks only change on the main thread, jobs only read them
+	wi::jobsystem::context ctx = {};
+	wi::jobsystem::Dispatch(ctx, batch->Viewers.Count, FOV_VIEWER_GROUP_SIZE, [batch, tilemap](wi::jobsystem::JobArgs job)
+		{
+			FovVisibility* result = &batch->Results.Memory[job.jobIndex];
+			FovComputeViewer(&batch->Viewers.Memory[job.jobIndex], result, batch->Bits.Memory + result->BitsOffset, tilemap);
+		}, 0);
+	wi::jobsystem::Wait(ctx);
+}
+
+void FovBatchClear(FovBatch* batch)
+{
+	batch->Viewers.Clear();
+	batch->Results.Clear();
+	batch->Bits.Clear();
+}
+
+void FovBatchFree(FovBatch* batch)
+{
+	batch->Viewers.Free();
+	batch->Results.Free();
+	batch->Bits.Free();
+}
+
+bool FovCanSee(const FovBatch* batch, uint32_t viewerIndex, Vector2i tile)
+{
+	SASSERT(viewerIndex < batch->Results.Count);
+	const FovVisibility* result = &batch->Results.Memory[viewerIndex];
+	int x = tile.x - result->Origin.x + result->Range;
+	int y = tile.y - result->Origin.y + result->Range;
+	int side = result->Range * 2 + 1;
+	if (x < 0 || y < 0 || x >= side || y >= side)
+		return false;
+
+	const uint64_t* row = batch->Bits.Memory + result->BitsOffset + y * result->RowWords;
+	return (row[x >> 6] >> (x & 63)) & 1;
+}
+
+int TestFieldOfView()
+{
+	constexpr int chunksWide = 2;
+	constexpr int viewerCount = 512;
+
+	TileData wall = TileMgrCreate(TileMgrRegister(ROCKY_WALL, TileType::Solid));
+	TileData floor = TileMgrCreate(TileMgrRegister(STONE_FLOOR, TileType::Floor));
+
+	ChunkedTileMap tilemap = {};
+	CTileMap::Initialize(&tilemap);
+
+	SRandom random;
+	SRandomInitialize(&random, 1337);
+
+	// Chunk (0, 0) is open floor with a wall at x = 20, y in [10, 30], the rest is scattered walls
+	size_t chunksSize = chunksWide * chunksWide * sizeof(TileMapChunk);
+	TileMapChunk* chunks = (TileMapChunk*)SAlloc(SAllocator::Malloc, chunksSize, MemoryTag::Game);
+	SMemClear(chunks, chunksSize);
+	for (int i = 0; i < chunksWide * chunksWide; ++i)
+	{
+		TileMapChunk* chunk = &chunks[i];
+		chunk->ChunkCoord = { i % chunksWide, i / chunksWide };
+		chunk->StartTile = { chunk->ChunkCoord.x * CHUNK_DIMENSIONS, chunk->ChunkCoord.y * CHUNK_DIMENSIONS };
+		chunk->State = ChunkState::Loaded;
+		for (int t = 0; t < CHUNK_SIZE; ++t)
+		{
+			if (i == 0)
+			{
+				int x = t & CHUNK_DIMENSIONS_MASK;
+				int y = t >> CHUNK_DIMENSIONS_SHIFT;
+				chunk->Tiles[t] = (x == 20 && y >= 10 && y <= 30) ? wall : floor;
+			}
+			else
+				chunk->Tiles[t] = (SRandNextRange(&random, 0, 99) < 10) ? wall : floor;
+		}
+		CTileMap::BuildSolidMasks(chunk);
+		tilemap.Chunks.Insert(&chunk->ChunkCoord, &chunk);
+	}
+
+	FovBatch batch = {};
+	FovViewer viewer = {};
+	viewer.Pos = { 10, 20 };
+	viewer.LookDir = TileDirection::East;
+	viewer.Range = 30;
+	viewer.ConeAngle = 0.0f;
+	uint32_t around = FovBatchAdd(&batch, &viewer);
+	viewer.ConeAngle = PI / 4.0f;
+	uint32_t cone = FovBatchAdd(&batch, &viewer);
+	FovBatchCompute(&batch, &tilemap);
+
+	int passed = 1;
+	passed &= FovCanSee(&batch, around, { 10, 20 });
+	passed &= FovCanSee(&batch, around, { 19, 20 });
+	passed &= FovCanSee(&batch, around, { 20, 20 });	// The wall itself
+	passed &= !FovCanSee(&batch, around, { 25, 20 });	// Behind the wall
+	passed &= FovCanSee(&batch, around, { 10, 45 });
+	passed &= !FovCanSee(&batch, around, { 10, 50 });	// Out of range
+	passed &= FovCanSee(&batch, cone, { 15, 21 });
+	passed &= !FovCanSee(&batch, cone, { 10, 30 });		// South, outside the cone
+	passed &= !FovCanSee(&batch, cone, { 4, 20 });		// Behind
+	if (!passed)
+		SLOG_ERR("[ FOV ] Visibility queries failed");
+
+	// Ranges past the octant masks are clamped, not overrun
+	viewer.Range = 200;
+	uint32_t clamped = FovBatchAdd(&batch, &viewer);
+	FovBatchCompute(&batch, &tilemap);
+	passed &= batch.Results.Memory[clamped].Range == FOV_MAX_RANGE;
+
+	// Batched results have to match computing every viewer alone on this thread
+	FovBatchClear(&batch);
+	int worldSize = chunksWide * CHUNK_DIMENSIONS;
+	for (int i = 0; i < viewerCount; ++i)
+	{
+		viewer.Pos.x = (int)SRandNextRange(&random, 0, worldSize - 1);
+		viewer.Pos.y = (int)SRandNextRange(&random, 0, worldSize - 1);
+		viewer.LookDir = (TileDirection)SRandNextRange(&random, 0, 3);
+		viewer.Range = (uint8_t)SRandNextRange(&random, 4, FOV_MAX_RANGE);
+		viewer.ConeAngle = (i & 1) ? PI / 3.0f : 0.0f;
+		FovBatchAdd(&batch, &viewer);
+	}
+
+	double batchTime = GetTime();
+	FovBatchCompute(&batch, &tilemap);
+	batchTime = GetTime() - batchTime;
+
+	SList<uint64_t> sequential = {};
+	sequential.Allocator = SAllocator::Temp;
+	sequential.EnsureSize(batch.Bits.Count);
+	double sequentialTime = GetTime();
+	for (uint32_t i = 0; i < batch.Viewers.Count; ++i)
+	{
+		FovVisibility result = batch.Results.Memory[i];
+		FovComputeViewer(&batch.Viewers.Memory[i], &result, sequential.Memory + result.BitsOffset, &tilemap);
+		if (result.VisibleCount != batch.Results.Memory[i].VisibleCount)
+			passed = 0;
+	}
+	sequentialTime = GetTime() - sequentialTime;
+
+	if (memcmp(sequential.Memory, batch.Bits.Memory, batch.Bits.Count * sizeof(uint64_t)) != 0)
+		passed = 0;
+
+	uint64_t visibleTiles = 0;
+	for (uint32_t i = 0; i < batch.Results.Count; ++i)
+		visibleTiles += batch.Results.Memory[i].VisibleCount;
+
+	SLOG_INFO("[ FOV ] %d viewers: batched %.3fms, one thread %.3fms, %llu visible tiles in %u bytes",
+		viewerCount, batchTime * 1000.0, sequentialTime * 1000.0, (unsigned long long)visibleTiles,
+		(uint32_t)(batch.Bits.Count * sizeof(uint64_t)));
+
+	FovBatchFree(&batch);
+	CTileMap::Free(&tilemap);
+	SFree(SAllocator::Malloc, chunks, chunksSize, MemoryTag::Game);
+	return passed;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Core.h"
+#include "Vector2i.h"
+#include "RowMaskFov.h"
+
+#include "Structures/SList.h"
+
+struct ChunkedTileMap;
+
+#define FOV_VIEWER_GROUP_SIZE 16 // Viewers per job
+
+constexpr global_var int FOV_MAX_RANGE = ROW_MASK_FOV_MAX_RADIUS;
+
+struct FovViewer
+{
+	Vector2i Pos;
+	TileDirection LookDir;
+	uint8_t Range;			// Tiles within distance < Range can be seen, at most FOV_MAX_RANGE
+	float ConeAngle;		// Half angle in radians around LookDir, 0 to see all around
+};
+
+// Visible tiles of 1 viewer, bit x of row y is tile Origin + (x, y) - Range
+struct FovVisibility
+{
+	Vector2i Origin;
+	uint32_t BitsOffset;	// Into FovBatch::Bits
+	uint16_t Range;
+	uint16_t RowWords;
+	uint32_t VisibleCount;
+};
+
+// Viewers added over a turn are computed together on the job system,
+// results stay valid until the batch is cleared.
+struct FovBatch
+{
+	SList<FovViewer> Viewers;
+	SList<FovVisibility> Results;
+	SList<uint64_t> Bits;
+};
+
+// Returns the viewer's index, used to query its results
+uint32_t FovBatchAdd(FovBatch* batch, const FovViewer* viewer);
+void FovBatchCompute(FovBatch* batch, ChunkedTileMap* tilemap);
+void FovBatchClear(FovBatch* batch);
+void FovBatchFree(FovBatch* batch);
+
+// Needs FovBatchCompute() to have run since the viewer was added
+bool FovCanSee(const FovBatch* batch, uint32_t viewerIndex, Vector2i tile);
+
+int TestFieldOfView();
@@ -0,0 +1,692 @@
+#include "FloodLighting.h"
+
+#include "ChunkedTileMap.h"
+#include "SRandom.h"
+#include "WickedEngine/Jobs.h"
+
+constexpr global_var int FloodNeighbors[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+
+internal _FORCE_INLINE_ ChunkCoord
+FloodChunkCoord(TileCoord coord)
+{
+	return { coord.x >> CHUNK_DIMENSIONS_SHIFT, coord.y >> CHUNK_DIMENSIONS_SHIFT };
+}
+
+internal _FORCE_INLINE_ uint16_t
+FloodLocalIndex(TileCoord coord)
+{
+	return (uint16_t)((coord.x & CHUNK_DIMENSIONS_MASK) + (coord.y & CHUNK_DIMENSIONS_MASK) * CHUNK_DIMENSIONS);
+}
+
+internal _FORCE_INLINE_ uint8_t
+FloodFalloffChannel(uint8_t level)
+{
+	return (level > FLOOD_LIGHT_FALLOFF) ? (uint8_t)(level - FLOOD_LIGHT_FALLOFF) : 0;
+}
+
+internal _FORCE_INLINE_ Color
+FloodFalloff(Color level)
+{
+	return { FloodFalloffChannel(level.r), FloodFalloffChannel(level.g),
+		FloodFalloffChannel(level.b), FloodFalloffChannel(level.a) };
+}
+
+internal _FORCE_INLINE_ bool
+FloodIsDark(Color level)
+{
+	return (level.r | level.g | level.b | level.a) == 0;
+}
+
+// Raises every channel to incoming, true if any got brighter
+internal _FORCE_INLINE_ bool
+FloodRaise(Color* level, Color incoming)
+{
+	if (incoming.r <= level->r && incoming.g <= level->g && incoming.b <= level->b && incoming.a <= level->a)
+		return false;
+
+	level->r = (incoming.r > level->r) ? incoming.r : level->r;
+	level->g = (incoming.g > level->g) ? incoming.g : level->g;
+	level->b = (incoming.b > level->b) ? incoming.b : level->b;
+	level->a = (incoming.a > level->a) ? incoming.a : level->a;
+	return true;
+}
+
+internal _FORCE_INLINE_ int
+FloodReach(Color level)
+{
+	uint8_t brightest = level.r;
+	brightest = (level.g > brightest) ? level.g : brightest;
+	brightest = (level.b > brightest) ? level.b : brightest;
+	brightest = (level.a > brightest) ? level.a : brightest;
+	return brightest / FLOOD_LIGHT_FALLOFF;
+}
+
+// Only for loaded chunks, light doesn't spread into unloaded ones
+internal FloodLightChunk*
+FloodGetChunk(FloodLightState* state, ChunkedTileMap* tilemap, ChunkCoord coord)
+{
+	FloodLightChunk** chunkPtr = state->Chunks.Get(&coord);
+	if (chunkPtr)
+		return *chunkPtr;
+
+	if (!CTileMap::GetChunk(tilemap, coord))
+		return nullptr;
+
+	FloodLightChunk* chunk = (FloodLightChunk*)SAlloc(SAllocator::Game, sizeof(FloodLightChunk), MemoryTag::Game);
+	SMemClear(chunk, sizeof(FloodLightChunk));
+	chunk->Coord = coord;
+
+	// Jobs push to these, Malloc is safe to use from any thread
+	chunk->Queue.Allocator = SAllocator::Malloc;
+	chunk->Outgoing.Allocator = SAllocator::Malloc;
+	state->Chunks.Insert(&coord, &chunk);
+	return chunk;
+}
+
+internal void
+FloodQueue(FloodLightState* state, FloodLightChunk* chunk, uint16_t localIdx)
+{
+	chunk->Queue.Push(&localIdx);
+	if (!chunk->IsActive)
+	{
+		chunk->IsActive = true;
+		state->Active.Push(&chunk);
+	}
+}
+
+// Raises the tile to level, queues it to spread if it got brighter
+internal void
+FloodSeed(FloodLightState* state, ChunkedTileMap* tilemap, TileCoord coord, Color level)
+{
+	FloodLightChunk* chunk = FloodGetChunk(state, tilemap, FloodChunkCoord(coord));
+	if (!chunk)
+		return;
+
+	uint16_t idx = FloodLocalIndex(coord);
+	if (FloodRaise(&chunk->Levels[idx], level))
+		FloodQueue(state, chunk, idx);
+}
+
+// Queues a lit tile to spread its current level again
+internal void
+FloodRespread(FloodLightState* state, TileCoord coord)
+{
+	ChunkCoord chunkCoord = FloodChunkCoord(coord);
+	FloodLightChunk** chunkPtr = state->Chunks.Get(&chunkCoord);
+	if (!chunkPtr)
+		return;
+
+	uint16_t idx = FloodLocalIndex(coord);
+	if (!FloodIsDark((*chunkPtr)->Levels[idx]))
+		FloodQueue(state, *chunkPtr, idx);
+}
+
+// Runs on a job, only touches the chunk's own levels and lists
+internal void
+FloodSpreadChunk(FloodLightChunk* chunk)
+{
+	const TileMapChunk* mapChunk = chunk->MapChunk;
+	TileCoord start = { chunk->Coord.x * CHUNK_DIMENSIONS, chunk->Coord.y * CHUNK_DIMENSIONS };
+
+	// Tiles pushed while spreading are read by this same loop
+	for (uint32_t head = 0; head < chunk->Queue.Count; ++head)
+	{
+		uint16_t idx = chunk->Queue.Memory[head];
+		int x = idx & CHUNK_DIMENSIONS_MASK;
+		int y = idx >> CHUNK_DIMENSIONS_SHIFT;
+		if ((mapChunk->SolidRows[y] >> x) & 1)
+			continue;
+
+		Color next = FloodFalloff(chunk->Levels[idx]);
+		if (FloodIsDark(next))
+			continue;
+
+		for (int i = 0; i < 4; ++i)
+		{
+			int nx = x + FloodNeighbors[i][0];
+			int ny = y + FloodNeighbors[i][1];
+			if (nx >= 0 && ny >= 0 && nx < CHUNK_DIMENSIONS && ny < CHUNK_DIMENSIONS)
+			{
+				uint16_t neighbor = (uint16_t)(nx + ny * CHUNK_DIMENSIONS);
+				if (FloodRaise(&chunk->Levels[neighbor], next))
+					chunk->Queue.Push(&neighbor);
+			}
+			else
+			{
+				FloodBorderTile border = { { start.x + nx, start.y + ny }, next };
+				chunk->Outgoing.Push(&border);
+			}
+		}
+	}
+	chunk->Queue.Clear();
+}
+
+// Spreads every queued tile. Each wave runs active chunks on the job system,
+// then hands tiles that left a chunk to their neighbour for the next wave.
+internal void
+FloodPropagate(FloodLightState* state, ChunkedTileMap* tilemap)
+{
+	SList<FloodLightChunk*> wave = {};
+	wave.Allocator = SAllocator::Temp;
+	while (state->Active.Count > 0)
+	{
+		wave.Clear();
+		for (uint32_t i = 0; i < state->Active.Count; ++i)
+		{
+			FloodLightChunk* chunk = state->Active.Memory[i];
+			chunk->IsActive = false;
+			chunk->MapChunk = CTileMap::GetChunk(tilemap, chunk->Coord);
+			if (chunk->MapChunk)
+				wave.Push(&chunk);
+			else
+				chunk->Queue.Clear();
+		}
+		state->Active.Clear();
+
+		if (wave.Count == 0)
+			break;
+
+		wi::jobsystem::context ctx = {};
+		wi::jobsystem::Dispatch(ctx, wave.Count, 1, [&wave](wi::jobsystem::JobArgs job)
+			{
+				FloodSpreadChunk(wave.Memory[job.jobIndex]);
+			}, 0);
+		wi::jobsystem::Wait(ctx);
+
+		for (uint32_t i = 0; i < wave.Count; ++i)
+		{
+			FloodLightChunk* chunk = wave.Memory[i];
+			for (uint32_t j = 0; j < chunk->Outgoing.Count; ++j)
+				FloodSeed(state, tilemap, chunk->Outgoing.Memory[j].Coord, chunk->Outgoing.Memory[j].Level);
+			chunk->Outgoing.Clear();
+		}
+	}
+}
+
+internal void
+FloodClearRect(FloodLightState* state, const FloodDirtyRect* rect)
+{
+	for (int y = rect->Min.y; y <= rect->Max.y; ++y)
+	{
+		for (int x = rect->Min.x; x <= rect->Max.x;)
+		{
+			ChunkCoord chunkCoord = FloodChunkCoord({ x, y });
+			int spanEnd = x + (CHUNK_DIMENSIONS - (x & CHUNK_DIMENSIONS_MASK));
+			spanEnd = (spanEnd > rect->Max.x + 1) ? rect->Max.x + 1 : spanEnd;
+
+			FloodLightChunk** chunkPtr = state->Chunks.Get(&chunkCoord);
+			if (chunkPtr)
+				SMemClear(&(*chunkPtr)->Levels[FloodLocalIndex({ x, y })], (spanEnd - x) * sizeof(Color));
+			x = spanEnd;
+		}
+	}
+}
+
+internal _FORCE_INLINE_ bool
+FloodInsideRect(const FloodDirtyRect* rect, Vector2i pos)
+{
+	return pos.x >= rect->Min.x && pos.y >= rect->Min.y && pos.x <= rect->Max.x && pos.y <= rect->Max.y;
+}
+
+// Clears every dirty rect, then relights them from the sources inside and the lit
+// tiles around them. Tiles outside a rect are at least FLOOD_LIGHT_MAX_REACH from
+// what changed, so their levels still hold and are spread back in.
+internal void
+FloodRelightDirty(FloodLightState* state, ChunkedTileMap* tilemap)
+{
+	for (uint32_t i = 0; i < state->Dirty.Count; ++i)
+		FloodClearRect(state, &state->Dirty.Memory[i]);
+
+	for (uint32_t i = 0; i < state->Dirty.Count; ++i)
+	{
+		FloodDirtyRect rect = state->Dirty.Memory[i];
+		for (int x = rect.Min.x; x <= rect.Max.x; ++x)
+		{
+			FloodRespread(state, { x, rect.Min.y - 1 });
+			FloodRespread(state, { x, rect.Max.y + 1 });
+		}
+		for (int y = rect.Min.y; y <= rect.Max.y; ++y)
+		{
+			FloodRespread(state, { rect.Min.x - 1, y });
+			FloodRespread(state, { rect.Max.x + 1, y });
+		}
+	}
+
+	for (uint32_t i = 0; i < state->Sources.Data.Count; ++i)
+	{
+		FloodLightSource* source = state->Sources.At(i);
+		if (!source)
+			continue;
+
+		for (uint32_t j = 0; j < state->Dirty.Count; ++j)
+		{
+			if (FloodInsideRect(&state->Dirty.Memory[j], source->Pos))
+			{
+				FloodSeed(state, tilemap, source->Pos, source->Level);
+				break;
+			}
+		}
+	}
+
+	state->Dirty.Clear();
+	FloodPropagate(state, tilemap);
+}
+
+internal void
+FloodFreeChunks(FloodLightState* state)
+{
+	for (uint32_t i = 0; i < state->Chunks.Capacity; ++i)
+	{
+		FloodLightChunk** chunkPtr = state->Chunks.Index(i);
+		if (!chunkPtr)
+			continue;
+
+		(*chunkPtr)->Queue.Free();
+		(*chunkPtr)->Outgoing.Free();
+		SFree(SAllocator::Game, *chunkPtr, sizeof(FloodLightChunk), MemoryTag::Game);
+	}
+	state->Chunks.Clear();
+	state->Active.Clear();
+}
+
+// Drops every level and spreads all sources again
+internal void
+FloodRebuild(FloodLightState* state, ChunkedTileMap* tilemap)
+{
+	FloodFreeChunks(state);
+	state->Dirty.Clear();
+	state->NeedsRebuild = false;
+
+	for (uint32_t i = 0; i < state->Sources.Data.Count; ++i)
+	{
+		FloodLightSource* source = state->Sources.At(i);
+		if (source)
+			FloodSeed(state, tilemap, source->Pos, source->Level);
+	}
+	FloodPropagate(state, tilemap);
+}
+
+internal void
+FloodLightsOnTileChanges(const TileChange* changes, uint32_t count, bool overflowed, void* userData)
+{
+	FloodLightState* state = (FloodLightState*)userData;
+	if (overflowed)
+	{
+		state->NeedsRebuild = true;
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (changes[i].Old.IsSolid() != changes[i].New.IsSolid())
+			FloodLightsTileChanged(state, changes[i].Coord);
+	}
+}
+
+// Light spreads into a loaded chunk, and light that went through an unloaded one is gone.
+// Either way only tiles within FLOOD_LIGHT_MAX_REACH of the chunk change.
+internal void
+FloodLightsOnChunkChange(ChunkCoord coord, bool loaded, void* userData)
+{
+	FloodLightState* state = (FloodLightState*)userData;
+	if (!loaded)
+	{
+		FloodLightChunk** chunkPtr = state->Chunks.Get(&coord);
+		if (chunkPtr)
+		{
+			FloodLightChunk* chunk = *chunkPtr;
+			for (uint32_t i = 0; chunk->IsActive && i < state->Active.Count; ++i)
+			{
+				if (state->Active.Memory[i] == chunk)
+				{
+					state->Active.RemoveAtFast(i);
+					break;
+				}
+			}
+			chunk->Queue.Free();
+			chunk->Outgoing.Free();
+			SFree(SAllocator::Game, chunk, sizeof(FloodLightChunk), MemoryTag::Game);
+			state->Chunks.Remove(&coord);
+		}
+	}
+
+	constexpr int reach = FLOOD_LIGHT_MAX_REACH;
+	Vector2i start = { coord.x * CHUNK_DIMENSIONS, coord.y * CHUNK_DIMENSIONS };
+	FloodDirtyRect rect = { start.Subtract({ reach, reach }), start.Add({ CHUNK_DIMENSIONS - 1 + reach, CHUNK_DIMENSIONS - 1 + reach }) };
+	state->Dirty.Push(&rect);
+}
+
+void FloodLightsInitialize(FloodLightState* state, ChunkedTileMap* tilemap)
+{
+	state->Chunks.Reserve(16);
+	state->JournalHandle = CTileMap::JournalSubscribe(tilemap, FloodLightsOnTileChanges, state);
+	state->ChunkHandle = CTileMap::ChunkSubscribe(tilemap, FloodLightsOnChunkChange, state);
+}
+
+void FloodLightsFree(FloodLightState* state, ChunkedTileMap* tilemap)
+{
+	if (state->JournalHandle >= 0)
+		CTileMap::JournalUnsubscribe(tilemap, state->JournalHandle);
+	if (state->ChunkHandle >= 0)
+		CTileMap::ChunkUnsubscribe(tilemap, state->ChunkHandle);
+
+	FloodFreeChunks(state);
+	state->Chunks.Free();
+	state->Active.Free();
+	state->Dirty.Free();
+	state->Sources.Data.Free();
+	state->Sources.FreeList.Free();
+	state->Sources.IndexOccupied.Free();
+	*state = {};
+}
+
+Color FloodLightSourceLevel(Color color, float radius)
+{
+	float brightest = (radius + 1.0f) * (float)FLOOD_LIGHT_FALLOFF;
+	float scale = ((brightest < (float)UINT8_MAX) ? brightest : (float)UINT8_MAX) / (float)UINT8_MAX;
+	return { (uint8_t)((float)color.r * scale), (uint8_t)((float)color.g * scale),
+		(uint8_t)((float)color.b * scale), (uint8_t)((float)color.a * scale) };
+}
+
+uint32_t FloodLightAdd(FloodLightState* state, ChunkedTileMap* tilemap, Vector2i pos, Color level)
+{
+	FloodLightSource source = { pos, level };
+	uint32_t id = state->Sources.Add(&source);
+
+	// Adding only brightens, levels spread out from the new source
+	FloodSeed(state, tilemap, pos, level);
+	FloodPropagate(state, tilemap);
+	return id;
+}
+
+void FloodLightRemove(FloodLightState* state, ChunkedTileMap* tilemap, uint32_t sourceId)
+{
+	FloodLightSource* source = state->Sources.RemoveAndGetPtr(sourceId);
+	if (!source)
+		return;
+
+	int reach = FloodReach(source->Level);
+	FloodDirtyRect rect = { source->Pos.Subtract({ reach, reach }), source->Pos.Add({ reach, reach }) };
+	state->Dirty.Push(&rect);
+	FloodRelightDirty(state, tilemap);
+}
+
+void FloodLightsTileChanged(FloodLightState* state, TileCoord coord)
+{
+	constexpr int reach = FLOOD_LIGHT_MAX_REACH;
+	FloodDirtyRect rect = { coord.Subtract({ reach, reach }), coord.Add({ reach, reach }) };
+	state->Dirty.Push(&rect);
+}
+
+void FloodLightsUpdate(FloodLightState* state, ChunkedTileMap* tilemap)
+{
+	if (state->NeedsRebuild)
+		FloodRebuild(state, tilemap);
+	else if (state->Dirty.Count > 0)
+		FloodRelightDirty(state, tilemap);
+}
+
+Color FloodLightGet(FloodLightState* state, TileCoord coord)
+{
+	ChunkCoord chunkCoord = FloodChunkCoord(coord);
+	FloodLightChunk** chunkPtr = state->Chunks.Get(&chunkCoord);
+	return (chunkPtr) ? (*chunkPtr)->Levels[FloodLocalIndex(coord)] : Color{};
+}
+
+internal _FORCE_INLINE_ uint8_t
+FloodAddChannel(uint8_t dst, uint8_t level)
+{
+	uint32_t sum = (uint32_t)dst + level;
+	return (uint8_t)((sum > UINT8_MAX) ? UINT8_MAX : sum);
+}
+
+void FloodLightsDraw(FloodLightState* state, Color* colors, Vector2i viewMin, Vector2i resolution)
+{
+	if (state->Sources.Size == 0)
+		return;
+
+	for (int y = 0; y < resolution.y; ++y)
+	{
+		int worldY = viewMin.y + y;
+		for (int x = 0; x < resolution.x;)
+		{
+			int worldX = viewMin.x + x;
+			int spanEnd = x + (CHUNK_DIMENSIONS - (worldX & CHUNK_DIMENSIONS_MASK));
+			spanEnd = (spanEnd > resolution.x) ? resolution.x : spanEnd;
+
+			ChunkCoord chunkCoord = FloodChunkCoord({ worldX, worldY });
+			FloodLightChunk** chunkPtr = state->Chunks.Get(&chunkCoord);
+			if (chunkPtr)
+			{
+				const Color* levels = &(*chunkPtr)->Levels[FloodLocalIndex({ worldX, worldY })];
+				Color* dst = &colors[x + y * resolution.x];
+				for (int i = 0; i < spanEnd - x; ++i)
+				{
+					dst[i].r = FloodAddChannel(dst[i].r, levels[i].r);
+					dst[i].g = FloodAddChannel(dst[i].g, levels[i].g);
+					dst[i].b = FloodAddChannel(dst[i].b, levels[i].b);
+					dst[i].a = FloodAddChannel(dst[i].a, levels[i].a);
+				}
+			}
+			x = spanEnd;
+		}
+	}
+}
+
+// Every source walked on its own, levels are the brightest of each channel
+internal void
+ReferenceFloodLevels(ChunkedTileMap* tilemap, const FloodLightSource* sources, uint32_t sourceCount,
+	int worldSize, Color* levels, int16_t* distances)
+{
+	SMemClear(levels, worldSize * worldSize * sizeof(Color));
+	for (int i = 0; i < worldSize * worldSize; ++i)
+		distances[i] = -1;
+
+	SList<Vector2i> queue = {};
+	queue.Allocator = SAllocator::Temp;
+	for (uint32_t s = 0; s < sourceCount; ++s)
+	{
+		const FloodLightSource* source = &sources[s];
+		queue.Clear();
+		queue.Push(&source->Pos);
+		distances[source->Pos.x + source->Pos.y * worldSize] = 0;
+		for (uint32_t head = 0; head < queue.Count; ++head)
+		{
+			Vector2i pos = queue.Memory[head];
+			if (!CTileMap::GetChunk(tilemap, FloodChunkCoord(pos)))
+				continue;
+
+			int distance = distances[pos.x + pos.y * worldSize];
+			int falloff = distance * FLOOD_LIGHT_FALLOFF;
+			Color* level = &levels[pos.x + pos.y * worldSize];
+			Color lit = {
+				(uint8_t)((source->Level.r > falloff) ? source->Level.r - falloff : 0),
+				(uint8_t)((source->Level.g > falloff) ? source->Level.g - falloff : 0),
+				(uint8_t)((source->Level.b > falloff) ? source->Level.b - falloff : 0),
+				(uint8_t)((source->Level.a > falloff) ? source->Level.a - falloff : 0) };
+			FloodRaise(level, lit);
+
+			if (FloodIsDark(FloodFalloff(lit)) || CTileMap::BlocksLight(tilemap, pos))
+				continue;
+
+			for (int i = 0; i < 4; ++i)
+			{
+				Vector2i next = { pos.x + FloodNeighbors[i][0], pos.y + FloodNeighbors[i][1] };
+				if (next.x < 0 || next.y < 0 || next.x >= worldSize || next.y >= worldSize)
+					continue;
+				int16_t* nextDistance = &distances[next.x + next.y * worldSize];
+				if (*nextDistance >= 0)
+					continue;
+				*nextDistance = (int16_t)(distance + 1);
+				queue.Push(&next);
+			}
+		}
+
+		// Reset only what this source visited
+		for (uint32_t i = 0; i < queue.Count; ++i)
+			distances[queue.Memory[i].x + queue.Memory[i].y * worldSize] = -1;
+	}
+}
+
+internal int
+FloodMismatches(FloodLightState* state, const Color* reference, int worldSize)
+{
+	int mismatches = 0;
+	for (int y = 0; y < worldSize; ++y)
+	{
+		for (int x = 0; x < worldSize; ++x)
+		{
+			Color level = FloodLightGet(state, { x, y });
+			Color expected = reference[x + y * worldSize];
+			if (level.r != expected.r || level.g != expected.g || level.b != expected.b || level.a != expected.a)
+				++mismatches;
+		}
+	}
+	return mismatches;
+}
+
+int TestFloodLighting()
+{
+	constexpr int chunksWide = 2;
+	constexpr int worldSize = chunksWide * CHUNK_DIMENSIONS;
+	constexpr int sourceCount = 400;
+	constexpr int removedCount = 150;
+	constexpr int changedTiles = 64;
+
+	TileData wall = TileMgrCreate(TileMgrRegister(ROCKY_WALL, TileType::Solid));
+	TileData floor = TileMgrCreate(TileMgrRegister(STONE_FLOOR, TileType::Floor));
+
+	ChunkedTileMap tilemap = {};
+	CTileMap::Initialize(&tilemap);
+
+	SRandom random;
+	SRandomInitialize(&random, 1337);
+
+	size_t chunksSize = chunksWide * chunksWide * sizeof(TileMapChunk);
+	TileMapChunk* chunks = (TileMapChunk*)SAlloc(SAllocator::Malloc, chunksSize, MemoryTag::Game);
+	SMemClear(chunks, chunksSize);
+	for (int i = 0; i < chunksWide * chunksWide; ++i)
+	{
+		TileMapChunk* chunk = &chunks[i];
+		chunk->ChunkCoord = { i % chunksWide, i / chunksWide };
+		chunk->StartTile = { chunk->ChunkCoord.x * CHUNK_DIMENSIONS, chunk->ChunkCoord.y * CHUNK_DIMENSIONS };
+		chunk->State = ChunkState::Loaded;
+		for (int t = 0; t < CHUNK_SIZE; ++t)
+			chunk->Tiles[t] = (SRandNextRange(&random, 0, 99) < 15) ? wall : floor;
+		CTileMap::BuildSolidMasks(chunk);
+		tilemap.Chunks.Insert(&chunk->ChunkCoord, &chunk);
+	}
+
+	FloodLightState state = {};
+	FloodLightsInitialize(&state, &tilemap);
+
+	// Radius 2 to 4 lights, the request's case of many small lights
+	SList<uint32_t> ids = {};
+	ids.Allocator = SAllocator::Temp;
+	double addTime = GetTime();
+	for (int i = 0; i < sourceCount; ++i)
+	{
+		Vector2i pos = { (int)SRandNextRange(&random, 0, worldSize - 1), (int)SRandNextRange(&random, 0, worldSize - 1) };
+		Color color = { (uint8_t)SRandNextRange(&random, 0, 255), (uint8_t)SRandNextRange(&random, 0, 255),
+			(uint8_t)SRandNextRange(&random, 0, 255), 255 };
+		float radius = (float)SRandNextRange(&random, 2, 4);
+		uint32_t id = FloodLightAdd(&state, &tilemap, pos, FloodLightSourceLevel(color, radius));
+		ids.Push(&id);
+	}
+	addTime = GetTime() - addTime;
+
+	SList<FloodLightSource> sources = {};
+	sources.Allocator = SAllocator::Temp;
+	auto gatherSources = [&state, &sources]()
+	{
+		sources.Clear();
+		for (uint32_t i = 0; i < state.Sources.Data.Count; ++i)
+		{
+			FloodLightSource* source = state.Sources.At(i);
+			if (source)
+				sources.Push(source);
+		}
+	};
+
+	Color* reference = (Color*)SAlloc(SAllocator::Malloc, worldSize * worldSize * sizeof(Color), MemoryTag::Game);
+	int16_t* distances = (int16_t*)SAlloc(SAllocator::Malloc, worldSize * worldSize * sizeof(int16_t), MemoryTag::Game);
+
+	int passed = 1;
+	gatherSources();
+	ReferenceFloodLevels(&tilemap, sources.Memory, sources.Count, worldSize, reference, distances);
+	int addMismatches = FloodMismatches(&state, reference, worldSize);
+
+	double removeTime = GetTime();
+	for (int i = 0; i < removedCount; ++i)
+		FloodLightRemove(&state, &tilemap, ids.Memory[i * 2]);
+	removeTime = GetTime() - removeTime;
+
+	gatherSources();
+	ReferenceFloodLevels(&tilemap, sources.Memory, sources.Count, worldSize, reference, distances);
+	int removeMismatches = FloodMismatches(&state, reference, worldSize);
+
+	// Flip tiles as SetTile() would, the journal reports them the same way
+	for (int i = 0; i < changedTiles; ++i)
+	{
+		TileCoord coord = { (int)SRandNextRange(&random, 0, worldSize - 1), (int)SRandNextRange(&random, 0, worldSize - 1) };
+		TileMapChunk* chunk = CTileMap::GetChunk(&tilemap, FloodChunkCoord(coord));
+		size_t idx = FloodLocalIndex(coord);
+		bool isSolid = !chunk->Tiles[idx].IsSolid();
+		chunk->Tiles[idx] = (isSolid) ? wall : floor;
+		CTileMap::SetSolidMask(chunk, idx, isSolid);
+		FloodLightsTileChanged(&state, coord);
+	}
+
+	double changeTime = GetTime();
+	FloodLightsUpdate(&state, &tilemap);
+	changeTime = GetTime() - changeTime;
+
+	ReferenceFloodLevels(&tilemap, sources.Memory, sources.Count, worldSize, reference, distances);
+	int changeMismatches = FloodMismatches(&state, reference, worldSize);
+
+	// Unloading drops light that went through the chunk, loading spreads it back
+	ChunkCoord streamed = { 1, 0 };
+	tilemap.Chunks.Remove(&streamed);
+	FloodLightsOnChunkChange(streamed, false, &state);
+	double unloadTime = GetTime();
+	FloodLightsUpdate(&state, &tilemap);
+	unloadTime = GetTime() - unloadTime;
+
+	ReferenceFloodLevels(&tilemap, sources.Memory, sources.Count, worldSize, reference, distances);
+	int unloadMismatches = FloodMismatches(&state, reference, worldSize);
+
+	TileMapChunk* streamedChunk = &chunks[streamed.x + streamed.y * chunksWide];
+	tilemap.Chunks.Insert(&streamed, &streamedChunk);
+	FloodLightsOnChunkChange(streamed, true, &state);
+	double loadTime = GetTime();
+	FloodLightsUpdate(&state, &tilemap);
+	loadTime = GetTime() - loadTime;
+
+	ReferenceFloodLevels(&tilemap, sources.Memory, sources.Count, worldSize, reference, distances);
+	int loadMismatches = FloodMismatches(&state, reference, worldSize);
+
+	state.NeedsRebuild = true;
+	double rebuildTime = GetTime();
+	FloodLightsUpdate(&state, &tilemap);
+	rebuildTime = GetTime() - rebuildTime;
+	int rebuildMismatches = FloodMismatches(&state, reference, worldSize);
+
+	passed &= addMismatches == 0 && removeMismatches == 0 && changeMismatches == 0
+		&& unloadMismatches == 0 && loadMismatches == 0 && rebuildMismatches == 0;
+	if (!passed)
+	{
+		SLOG_ERR("[ Lights ] Flood levels differ from walking each source: %d added, %d removed, %d tile changes, %d unloaded, %d loaded, %d rebuilt",
+			addMismatches, removeMismatches, changeMismatches, unloadMismatches, loadMismatches, rebuildMismatches);
+	}
+
+	SLOG_INFO("[ Lights ] Flood: %d sources added %.3fms, %d removed %.3fms, %d tile changes %.3fms, chunk unload %.3fms, load %.3fms, full respread %.3fms",
+		sourceCount, addTime * 1000.0, removedCount, removeTime * 1000.0, changedTiles, changeTime * 1000.0,
+		unloadTime * 1000.0, loadTime * 1000.0, rebuildTime * 1000.0);
+
+	SFree(SAllocator::Malloc, reference, worldSize * worldSize * sizeof(Color), MemoryTag::Game);
+	SFree(SAllocator::Malloc, distances, worldSize * worldSize * sizeof(int16_t), MemoryTag::Game);
+	FloodLightsFree(&state, &tilemap);
+	CTileMap::Free(&tilemap);
+	SFree(SAllocator::Malloc, chunks, chunksSize, MemoryTag::Game);
+	return passed;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Core.h"
+#include "Vector2i.h"
+
+#include "Structures/SList.h"
+#include "Structures/SHashMap.h"
+#include "Structures/IndexArray.h"
+
+struct ChunkedTileMap;
+struct TileMapChunk;
+struct TileChange;
+
+#define FLOOD_LIGHT_FALLOFF 32 // Levels every channel loses per tile stepped
+#define FLOOD_LIGHT_MAX_REACH (UINT8_MAX / FLOOD_LIGHT_FALLOFF) // Tiles the brightest level reaches
+
+// Minecraft style lights. Every tile keeps the brightest level any source reaches it
+// with, walking 4 way over non solid tiles and losing FLOOD_LIGHT_FALLOFF per step.
+// Solid tiles are lit but stop the light. Meant for many small lights that rarely
+// change: levels are spread once, then patched around added or removed sources and
+// changed tiles.
+struct FloodLightSource
+{
+	Vector2i Pos;
+	Color Level;	// Per channel level at Pos
+};
+
+// Spread tile leaving its chunk, handed to the neighbour after the wave
+struct FloodBorderTile
+{
+	TileCoord Coord;
+	Color Level;
+};
+
+struct FloodLightChunk
+{
+	Color Levels[CHUNK_SIZE];
+	SList<uint16_t> Queue;				// Local tiles to spread from in the next wave
+	SList<FloodBorderTile> Outgoing;	// Written by the chunk's job, exchanged between waves
+	TileMapChunk* MapChunk;				// Looked up before each wave
+	ChunkCoord Coord;
+	bool IsActive;
+};
+
+// Inclusive tile rect to clear and relight
+struct FloodDirtyRect
+{
+	Vector2i Min;
+	Vector2i Max;
+};
+
+struct FloodLightState
+{
+	SHashMap<ChunkCoord, FloodLightChunk*> Chunks;	// Chunks light has reached
+	IndexArray<FloodLightSource> Sources;
+	SList<FloodLightChunk*> Active;					// Chunks with queued tiles
+	SList<FloodDirtyRect> Dirty;
+	int JournalHandle;
+	int ChunkHandle;
+	bool NeedsRebuild;
+};
+
+void FloodLightsInitialize(FloodLightState* state, ChunkedTileMap* tilemap);
+void FloodLightsFree(FloodLightState* state, ChunkedTileMap* tilemap);
+
+// Level of a light of color reaching about radius tiles
+Color FloodLightSourceLevel(Color color, float radius);
+
+uint32_t FloodLightAdd(FloodLightState* state, ChunkedTileMap* tilemap, Vector2i pos, Color level);
+void FloodLightRemove(FloodLightState* state, ChunkedTileMap* tilemap, uint32_t sourceId);
+
+// Relights around tiles that changed solidity, batched until FloodLightsUpdate()
+void FloodLightsTileChanged(FloodLightState* state, TileCoord coord);
+
+// Relights around changed tiles and loaded or unloaded chunks, respreads
+// everything if tile changes were lost
+void FloodLightsUpdate(FloodLightState* state, ChunkedTileMap* tilemap);
+
+Color FloodLightGet(FloodLightState* state, TileCoord coord);
+
+// Saturating adds levels of the view's tiles into colors, resolution.x tiles per row
+void FloodLightsDraw(FloodLightState* state, Color* colors, Vector2i viewMin, Vector2i resolution);
+
+int TestFloodLighting();
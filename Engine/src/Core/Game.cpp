@@ -6,6 +6,12 @@
 #include "SUtil.h"
 #include "SString.h"
 #include "SEntity.h"
+#include "ThreadedLights.h"
+#include "FieldOfView.h"
+#include "FloodLighting.h"
+#include "LightTracer.h"
+#include "ChunkFile.h"
+#include "Scheduler.h"
 
 #include "Structures/SArray.h"
 #include "Structures/SList.h"
@@ -15,6 +21,9 @@
 #include "Structures/References.h"
 #include "Structures/IndexArray.h"
 
+#include "MapGeneration/NoiseBatch.h"
+#include "MapGeneration/CellularCaves.h"
+
 #include "WickedEngine/Jobs.h"
 
 #include "raymath.h"
@@ -85,6 +94,22 @@ SAPI bool GameApplication::Start()
 	GAME_TEST(TreeTest);
 	GAME_TEST(TestRef);
 	GAME_TEST(TestIndexArray);
+	GAME_TEST(TestNoiseBatch);
+	GAME_TEST(TestCellularCaves);
+	GAME_TEST(TestCounterRandom);
+	GAME_TEST(TestRandomLanes);
+	GAME_TEST(TestShadowcastKernels);
+	GAME_TEST(TestRowMaskFov);
+	GAME_TEST(TestPlayerFovCache);
+	GAME_TEST(TestFieldOfView);
+	GAME_TEST(TestLightAttenuation);
+	GAME_TEST(TestLightLod);
+	GAME_TEST(TestLightRebuildScheduler);
+	GAME_TEST(TestLightTileChanges);
+	GAME_TEST(TestFloodLighting);
+	GAME_TEST(TestLightTracer);
+	GAME_TEST(TestChunkSpill);
+	GAME_TEST(TestTileCatchUp);
 
 	SLOG_INFO("[ Tests ] %d/%d tests passed!", passingTests, totalTests);
 #endif // SCAL_GAME_TESTS
@@ -138,9 +163,9 @@ internal void
 GameLoad(Game* game, GameApplication* gameApp)
 {
 
-	LightsInitialize(&game->LightingState);
-
 	UniverseInitialize(&game->Universe, gameApp);
+
+	LightsInitialize(&game->LightingState, &game->Universe.World.ChunkedTileMap);
 	UniverseLoad(&game->Universe, gameApp);
 }
 
@@ -342,9 +367,27 @@ HandleGameInput(GameApplication* gameApp, Game* game)
 	if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
 	{
 		Vector2i clickedTilePos = GetTileFromMouse(game);
-		if (CTileMap::IsTileInBounds(&game->Universe.World.ChunkedTileMap, clickedTilePos))
+		TileData* tile = CTileMap::GetTile(&game->Universe.World.ChunkedTileMap, clickedTilePos);
+		if (tile && IsKeyDown(KEY_LEFT_SHIFT))
+		{
+			// Stamps a 30x30 room around the clicked tile
+			constexpr int roomSize = 30;
+			TileData wall = TileMgrCreate(TileMgrToTileId(ROCKY_WALL));
+			TileData floor = TileMgrCreate(TileMgrToTileId(STONE_FLOOR));
+			TileEditBatch batch = {};
+			for (int y = 0; y < roomSize; ++y)
+			{
+				for (int x = 0; x < roomSize; ++x)
+				{
+					bool isEdge = x == 0 || y == 0 || x == roomSize - 1 || y == roomSize - 1;
+					Vector2i pos = clickedTilePos + Vector2i{ x - roomSize / 2, y - roomSize / 2 };
+					batch.Add(pos, (isEdge) ? &wall : &floor);
+				}
+			}
+			CTileMap::ApplyEditBatch(&game->Universe.World.ChunkedTileMap, &batch);
+		}
+		else if (tile)
 		{
-			TileData* tile = CTileMap::GetTile(&game->Universe.World.ChunkedTileMap, clickedTilePos);
 			TileData newTile = TileMgrCreate(TileMgrToTileId(ROCKY_WALL));
 			CTileMap::SetTile(&game->Universe.World.ChunkedTileMap, &newTile, clickedTilePos);
 			SLOG_INFO("Clicked Tile[%d, %d] Id: %u", clickedTilePos.x, clickedTilePos.y, TileMgrToTileId(tile->AsCoord()));
@@ -353,7 +396,7 @@ HandleGameInput(GameApplication* gameApp, Game* game)
 	if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT))
 	{
 		Vector2i clickedTilePos = GetTileFromMouse(game);
-		if (CTileMap::IsTileInBounds(&game->Universe.World.ChunkedTileMap, clickedTilePos))
+		if (CTileMap::GetChunkByTile(&game->Universe.World.ChunkedTileMap, clickedTilePos))
 		{
 			UpdatingLight light = {};
 			light.EntityId = ENTITY_NOT_FOUND;
@@ -368,15 +411,25 @@ HandleGameInput(GameApplication* gameApp, Game* game)
 			light.Colors[3] = { 0xbf, 0x05, 0x00, 255 };
 			light.Color = light.Colors[0];
 			light.Radius = light.MaxIntensity;
-			LightAddUpdating(&GetGame()->LightingState, &light);
+
+			// Shift places small flood lights
+			if (IsKeyDown(KEY_LEFT_SHIFT))
+			{
+				light.LightType = LightType::Flood;
+				light.Radius = 3.0f;
+			}
+			LightAdd(&GetGame()->LightingState, &game->Universe.World.ChunkedTileMap, &light);
 		}
 	}
 	if (IsMouseButtonPressed(MOUSE_BUTTON_MIDDLE))
 	{
 		Vector2i clickedTilePos = GetTileFromMouse(game);
-		if (CTileMap::IsTileInBounds(&game->Universe.World.ChunkedTileMap, clickedTilePos))
+		TileData* tile = CTileMap::GetTile(&game->Universe.World.ChunkedTileMap, clickedTilePos);
+		if (tile)
 		{
-			CTileMap::GetTile(&game->Universe.World.ChunkedTileMap, clickedTilePos)->HasCeiling = true;
+			TileData newTile = *tile;
+			newTile.HasCeiling = true;
+			CTileMap::SetTile(&game->Universe.World.ChunkedTileMap, &newTile, clickedTilePos);
 		}
 	}
 
@@ -393,6 +446,21 @@ HandleGameInput(GameApplication* gameApp, Game* game)
 		else
 			game->ViewCamera.zoom = 1.f;
 	}
+	if (IsKeyPressed(KEY_F5))
+	{
+		game->UseRowMaskFov = !game->UseRowMaskFov;
+		SLOG_INFO("[ Lights ] Player FOV: %s", (game->UseRowMaskFov) ? "row masks" : "shadowcasting");
+	}
+	if (IsKeyPressed(KEY_F6))
+	{
+		game->UseLightLod = !game->UseLightLod;
+		SLOG_INFO("[ Lights ] Light LOD: %s", (game->UseLightLod) ? "on" : "off");
+	}
+	if (IsKeyPressed(KEY_F7))
+	{
+		game->UseLightTracer = !game->UseLightTracer;
+		SLOG_INFO("[ Lights ] Updating lights: %s", (game->UseLightTracer) ? "light tracer" : "shadowcasting");
+	}
 }
 
 SAPI void GameApplication::Shutdown()
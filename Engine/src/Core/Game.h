@@ -62,6 +62,9 @@ struct Game
     bool DebugDisableDarkess;
     bool DebugDisableFOV;
     bool DebugTileView;
+    bool UseRowMaskFov;     // Player FOV from RowMaskComputeOctant(), instead of ComputeOctant()
+    bool UseLightLod;       // Merge and downgrade updating lights, see LightLodPass()
+    bool UseLightTracer;    // Draw updating lights with LightTracerDraw(), instead of shadowcasting
 };
 
 struct View
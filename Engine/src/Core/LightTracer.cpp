@@ -0,0 +1,363 @@
+#include "LightTracer.h"
+
+#include "Game.h"
+#include "ChunkedTileMap.h"
+#include "Lighting.h"
+#include "ThreadedLights.h"
+#include "SRandom.h"
+#include "WickedEngine/Jobs.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define LIGHT_TRACER_SSE2 1
+	#include <emmintrin.h>
+#endif
+
+// Per channel sums of 1 screen row, r g b a planes
+typedef float TracerRow[4][LIGHT_TRACER_MAX_WIDTH];
+
+// Adds light to tiles [start, end) of the row, dx of tile x is offsetX + x
+template<bool UseSimd>
+internal _FORCE_INLINE_ void
+TraceSpan(const LightTracerLight* light, TracerRow accum, int start, int end, float offsetX, float dySqr)
+{
+	// Same constants as light_tracer.comp
+	constexpr LightFalloffProfile profile = LightFalloffProfiles[(size_t)LightFalloff::Quadratic];
+	float r = (float)light->Color.r;
+	float g = (float)light->Color.g;
+	float b = (float)light->Color.b;
+
+	int x = start;
+#if LIGHT_TRACER_SSE2
+	if constexpr (UseSimd)
+	{
+		const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 falloffA = _mm_set1_ps(profile.A);
+		const __m128 falloffB = _mm_set1_ps(profile.B);
+		const __m128 dy = _mm_set1_ps(dySqr);
+		const __m128 red = _mm_set1_ps(r);
+		const __m128 green = _mm_set1_ps(g);
+		const __m128 blue = _mm_set1_ps(b);
+		const __m128 lit = _mm_set1_ps(255.0f);
+		for (; x + 4 <= end; x += 4)
+		{
+			__m128 dx = _mm_add_ps(_mm_set1_ps(offsetX + (float)x), lanes);
+			__m128 distanceSqr = _mm_add_ps(_mm_mul_ps(dx, dx), dy);
+			__m128 distance = _mm_sqrt_ps(distanceSqr);
+			__m128 denominator = _mm_add_ps(one, _mm_add_ps(_mm_mul_ps(falloffA, distance), _mm_mul_ps(falloffB, distanceSqr)));
+			__m128 attenuation = _mm_div_ps(one, denominator);
+			_mm_storeu_ps(&accum[0][x], _mm_add_ps(_mm_loadu_ps(&accum[0][x]), _mm_mul_ps(red, attenuation)));
+			_mm_storeu_ps(&accum[1][x], _mm_add_ps(_mm_loadu_ps(&accum[1][x]), _mm_mul_ps(green, attenuation)));
+			_mm_storeu_ps(&accum[2][x], _mm_add_ps(_mm_loadu_ps(&accum[2][x]), _mm_mul_ps(blue, attenuation)));
+			_mm_storeu_ps(&accum[3][x], lit);
+		}
+	}
+#endif
+
+	for (; x < end; ++x)
+	{
+		float dx = offsetX + (float)x;
+		float distanceSqr = dx * dx + dySqr;
+		float attenuation = 1.0f / (1.0f + profile.A * sqrtf(distanceSqr) + profile.B * distanceSqr);
+		accum[0][x] += r * attenuation;
+		accum[1][x] += g * attenuation;
+		accum[2][x] += b * attenuation;
+		accum[3][x] = 255.0f;
+	}
+}
+
+// Saturating adds the sums of tiles [start, end) into row
+template<bool UseSimd>
+internal _FORCE_INLINE_ void
+WriteSpan(Color* row, TracerRow accum, int start, int end)
+{
+	int x = start;
+#if LIGHT_TRACER_SSE2
+	if constexpr (UseSimd)
+	{
+		// Transposed to 4 rgba tiles, packing saturates to 0 - 255
+		const __m128 maxLevel = _mm_set1_ps(255.0f);
+		for (; x + 4 <= end; x += 4)
+		{
+			__m128 r = _mm_min_ps(_mm_loadu_ps(&accum[0][x]), maxLevel);
+			__m128 g = _mm_min_ps(_mm_loadu_ps(&accum[1][x]), maxLevel);
+			__m128 b = _mm_min_ps(_mm_loadu_ps(&accum[2][x]), maxLevel);
+			__m128 a = _mm_min_ps(_mm_loadu_ps(&accum[3][x]), maxLevel);
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+			__m128i low = _mm_packs_epi32(_mm_cvttps_epi32(r), _mm_cvttps_epi32(g));
+			__m128i high = _mm_packs_epi32(_mm_cvttps_epi32(b), _mm_cvttps_epi32(a));
+			__m128i levels = _mm_packus_epi16(low, high);
+			__m128i* dst = (__m128i*)&row[x];
+			_mm_storeu_si128(dst, _mm_adds_epu8(_mm_loadu_si128(dst), levels));
+		}
+	}
+#endif
+
+	for (; x < end; ++x)
+	{
+		uint8_t* channels = &row[x].r;
+		for (int c = 0; c < 4; ++c)
+		{
+			float value = (float)channels[c] + accum[c][x];
+			channels[c] = (uint8_t)((value > 255.0f) ? 255.0f : value);
+		}
+	}
+}
+
+template<bool UseSimd>
+internal void
+TraceRow(const LightTracerLight* lights, uint32_t count, ChunkedTileMap* tilemap, Color* row, int worldY, Vector2i viewMin, int width)
+{
+	alignas(16) TracerRow accum;
+	for (int c = 0; c < 4; ++c)
+		SMemClear(accum[c], width * sizeof(float));
+
+	bool isLit = false;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const LightTracerLight* light = &lights[i];
+		float dy = (float)worldY - light->Pos.y;
+		float spanSqr = light->Radius * light->Radius - dy * dy;
+		if (spanSqr < 0.0f)
+			continue;
+
+		float span = sqrtf(spanSqr);
+		int start = (int)ceilf(light->Pos.x - span) - viewMin.x;
+		int end = (int)floorf(light->Pos.x + span) - viewMin.x + 1;
+		start = (start < 0) ? 0 : start;
+		end = (end > width) ? width : end;
+		if (start >= end)
+			continue;
+
+		isLit = true;
+		TraceSpan<UseSimd>(light, accum, start, end, (float)viewMin.x - light->Pos.x, dy * dy);
+	}
+
+	if (!isLit)
+		return;
+
+	// Chunk by chunk, worldMap has no alpha where nothing is loaded
+	int x = 0;
+	while (x < width)
+	{
+		TileCoord tile = { viewMin.x + x, worldY };
+		int chunkEnd = x + CHUNK_DIMENSIONS - (tile.x & CHUNK_DIMENSIONS_MASK);
+		chunkEnd = (chunkEnd > width) ? width : chunkEnd;
+		if (CTileMap::GetChunkByTile(tilemap, tile))
+			WriteSpan<UseSimd>(row, accum, x, chunkEnd);
+		x = chunkEnd;
+	}
+}
+
+void LightTracerDraw(const LightTracerLight* lights, uint32_t count, ChunkedTileMap* tilemap,
+	Color* colors, Vector2i viewMin, Vector2i resolution)
+{
+	SASSERT(resolution.x > 0 && resolution.x <= LIGHT_TRACER_MAX_WIDTH);
+	if (count == 0)
+		return;
+
+	// Every job owns its rows, chunks only change on the main thread
+	wi::jobsystem::context ctx = {};
+	wi::jobsystem::Dispatch(ctx, resolution.y, LIGHT_TRACER_ROWS_PER_JOB,
+		[lights, count, tilemap, colors, viewMin, resolution](wi::jobsystem::JobArgs job)
+		{
+			int y = (int)job.jobIndex;
+			TraceRow<true>(lights, count, tilemap, colors + y * resolution.x, viewMin.y + y, viewMin, resolution.x);
+		}, 0);
+	wi::jobsystem::Wait(ctx);
+}
+
+internal void
+TracerTestLightUpdate(Light* light, Game* game, float dt)
+{
+}
+
+int TestLightTracer()
+{
+	constexpr int lightCount = 512;
+	constexpr int margin = 16;
+
+	TileData wall = TileMgrCreate(TileMgrRegister(ROCKY_WALL, TileType::Solid));
+	TileData floor = TileMgrCreate(TileMgrRegister(STONE_FLOOR, TileType::Floor));
+
+	// Drawn into the game's view so the shadowcasting path can be timed on the same scene
+	View* view = &GetGameApp()->View;
+	Vector2i viewMin = view->ScreenXYInTiles;
+	Vector2i resolution = view->ResolutionInTiles;
+	uint32_t tileCount = (uint32_t)resolution.x * (uint32_t)resolution.y;
+	SASSERT(resolution.x <= LIGHT_TRACER_MAX_WIDTH);
+
+	ChunkedTileMap tilemap = {};
+	CTileMap::Initialize(&tilemap);
+
+	SRandom random;
+	SRandomInitialize(&random, 1337);
+
+	// Loaded around the view, except the view's bottom right chunk so some tiles fail the worldMap test
+	ChunkCoord chunkMin = CTileMap::TileToChunkCoord(viewMin.Subtract({ margin, margin }));
+	ChunkCoord chunkMax = CTileMap::TileToChunkCoord(viewMin.Add(resolution).Add({ margin, margin }));
+	ChunkCoord unloaded = CTileMap::TileToChunkCoord(viewMin.Add(resolution).Subtract({ 1, 1 }));
+	int chunksWide = chunkMax.x - chunkMin.x + 1;
+	int chunkCount = chunksWide * (chunkMax.y - chunkMin.y + 1);
+	size_t chunksSize = chunkCount * sizeof(TileMapChunk);
+	TileMapChunk* chunks = (TileMapChunk*)SAlloc(SAllocator::Malloc, chunksSize, MemoryTag::Game);
+	SMemClear(chunks, chunksSize);
+	for (int i = 0; i < chunkCount; ++i)
+	{
+		TileMapChunk* chunk = &chunks[i];
+		chunk->ChunkCoord = { chunkMin.x + i % chunksWide, chunkMin.y + i / chunksWide };
+		if (chunk->ChunkCoord == unloaded)
+			continue;
+
+		chunk->StartTile = { chunk->ChunkCoord.x * CHUNK_DIMENSIONS, chunk->ChunkCoord.y * CHUNK_DIMENSIONS };
+		chunk->State = ChunkState::Loaded;
+		for (int t = 0; t < CHUNK_SIZE; ++t)
+			chunk->Tiles[t] = (SRandNextRange(&random, 0, 99) < 10) ? wall : floor;
+		CTileMap::BuildSolidMasks(chunk);
+		tilemap.Chunks.Insert(&chunk->ChunkCoord, &chunk);
+	}
+
+	LightTracerLight* lights = (LightTracerLight*)SAlloc(SAllocator::Temp, lightCount * sizeof(LightTracerLight), MemoryTag::Game);
+	for (int i = 0; i < lightCount; ++i)
+	{
+		lights[i].Pos.x = (float)SRandNextRangeSigned(&random, viewMin.x - margin, viewMin.x + resolution.x + margin);
+		lights[i].Pos.y = (float)SRandNextRangeSigned(&random, viewMin.y - margin, viewMin.y + resolution.y + margin);
+		lights[i].Radius = (float)SRandNextRange(&random, 4, 16);
+		lights[i].Color.r = (uint8_t)SRandNextRange(&random, 0, 255);
+		lights[i].Color.g = (uint8_t)SRandNextRange(&random, 0, 255);
+		lights[i].Color.b = (uint8_t)SRandNextRange(&random, 0, 255);
+		lights[i].Color.a = 255;
+	}
+
+	// Dim base so sums don't all saturate
+	size_t colorsSize = tileCount * sizeof(Color);
+	Color* traced = (Color*)SAlloc(SAllocator::Temp, colorsSize, MemoryTag::Game);
+	Color* scalar = (Color*)SAlloc(SAllocator::Temp, colorsSize, MemoryTag::Game);
+	Color* base = (Color*)SAlloc(SAllocator::Temp, colorsSize, MemoryTag::Game);
+	for (uint32_t i = 0; i < tileCount; ++i)
+		base[i] = { (uint8_t)(i & 15), (uint8_t)(i & 7), 0, 0 };
+	SMemCopy(traced, base, colorsSize);
+	SMemCopy(scalar, base, colorsSize);
+
+	// Only a few lights, a lot of them saturate every tile
+	constexpr uint32_t checkedLights = 24;
+	LightTracerDraw(lights, checkedLights, &tilemap, traced, viewMin, resolution);
+	for (int y = 0; y < resolution.y; ++y)
+		TraceRow<false>(lights, checkedLights, &tilemap, scalar + y * resolution.x, viewMin.y + y, viewMin, resolution.x);
+
+	// Against the shader's math per tile, and the scalar path
+	int passed = 1;
+	int maxDiff = 0;
+	constexpr LightFalloffProfile profile = LightFalloffProfiles[(size_t)LightFalloff::Quadratic];
+	for (int y = 0; y < resolution.y; ++y)
+	{
+		for (int x = 0; x < resolution.x; ++x)
+		{
+			uint32_t idx = (uint32_t)(x + y * resolution.x);
+			Vector2i tile = { viewMin.x + x, viewMin.y + y };
+			bool isLoaded = CTileMap::GetChunkByTile(&tilemap, tile) != nullptr;
+
+			double sums[4] = {};
+			for (uint32_t i = 0; i < checkedLights; ++i)
+			{
+				double dx = (double)tile.x - lights[i].Pos.x;
+				double dy = (double)tile.y - lights[i].Pos.y;
+				double distance = sqrt(dx * dx + dy * dy);
+				if (distance > lights[i].Radius)
+					continue;
+
+				double attenuation = 1.0 / (1.0 + profile.A * distance + profile.B * distance * distance);
+				sums[0] += lights[i].Color.r * attenuation;
+				sums[1] += lights[i].Color.g * attenuation;
+				sums[2] += lights[i].Color.b * attenuation;
+				sums[3] = 255.0;
+			}
+
+			const uint8_t* baseChannels = &base[idx].r;
+			const uint8_t* tracedChannels = &traced[idx].r;
+			const uint8_t* scalarChannels = &scalar[idx].r;
+			for (int c = 0; c < 4; ++c)
+			{
+				double expected = (isLoaded) ? baseChannels[c] + sums[c] : baseChannels[c];
+				expected = (expected > 255.0) ? 255.0 : expected;
+				int diff = abs((int)tracedChannels[c] - (int)expected);
+				int scalarDiff = abs((int)tracedChannels[c] - (int)scalarChannels[c]);
+				maxDiff = (diff > maxDiff) ? diff : maxDiff;
+				maxDiff = (scalarDiff > maxDiff) ? scalarDiff : maxDiff;
+			}
+		}
+	}
+	if (maxDiff > 1)
+	{
+		SLOG_ERR("[ LightTracer ] Traced colors are %d levels off", maxDiff);
+		passed = 0;
+	}
+
+	// Same scene through the shadowcasting path, rebuilding every cache like moving
+	// lights, then drawing them cached like lights that stand still
+	LightAttenuationInitialize();
+	size_t updatingSize = lightCount * sizeof(UpdatingLight);
+	UpdatingLight* updating = (UpdatingLight*)SAlloc(SAllocator::Temp, updatingSize, MemoryTag::Game);
+	SMemClear(updating, updatingSize);
+	for (int i = 0; i < lightCount; ++i)
+	{
+		UpdatingLight* light = &updating[i];
+		int radius = (int)lights[i].Radius;
+		light->UpdateFunc = TracerTestLightUpdate;
+		light->Pos = Vector2i::FromVec2(lights[i].Pos);
+		light->Radius = lights[i].Radius;
+		light->Color = lights[i].Color;
+		light->LightType = LightType::Updating;
+		light->Falloff = LightFalloff::Quadratic;
+		light->MaxIntensity = lights[i].Radius;
+		light->Cache.Radius = radius;
+		light->Cache.Capacity = (radius * 2 + 1) * (radius * 2 + 1);
+		light->Cache.Tiles = (LightCacheTile*)SAlloc(SAllocator::Malloc, light->Cache.Capacity * sizeof(LightCacheTile), MemoryTag::Game);
+	}
+
+	Color* shadowcast = (Color*)SAlloc(SAllocator::Temp, colorsSize, MemoryTag::Game);
+	SMemClear(shadowcast, colorsSize);
+	double rebuildTime = 0.0;
+	double cachedTime = 0.0;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		double start = GetTime();
+		for (int i = 0; i < lightCount; ++i)
+		{
+			VisibleLight visible = {};
+			visible.Light = &updating[i];
+			visible.Intensity = 1;
+			visible.Rebuild = (pass == 0);
+			ThreadedLightUpdate(&visible, shadowcast, &tilemap, resolution.x);
+		}
+		double time = GetTime() - start;
+		if (pass == 0)
+			rebuildTime = time;
+		else
+			cachedTime = time;
+	}
+
+	SMemCopy(traced, base, colorsSize);
+	double tracedTime = GetTime();
+	LightTracerDraw(lights, lightCount, &tilemap, traced, viewMin, resolution);
+	tracedTime = GetTime() - tracedTime;
+
+	SMemCopy(scalar, base, colorsSize);
+	double oneThreadTime = GetTime();
+	for (int y = 0; y < resolution.y; ++y)
+		TraceRow<true>(lights, lightCount, &tilemap, scalar + y * resolution.x, viewMin.y + y, viewMin, resolution.x);
+	oneThreadTime = GetTime() - oneThreadTime;
+
+	SLOG_INFO("[ LightTracer ] %d lights on %dx%d tiles: traced %.3fms (%.3fms one thread), shadowcast %.3fms rebuilding, %.3fms cached",
+		lightCount, resolution.x, resolution.y, tracedTime * 1000.0, oneThreadTime * 1000.0, rebuildTime * 1000.0, cachedTime * 1000.0);
+	SLOG_INFO("[ LightTracer ] Faster for moving lights: %s, for still lights: %s",
+		(tracedTime < rebuildTime) ? "tracer" : "shadowcasting", (tracedTime < cachedTime) ? "tracer" : "shadowcasting");
+
+	for (int i = 0; i < lightCount; ++i)
+		SFree(SAllocator::Malloc, updating[i].Cache.Tiles, updating[i].Cache.Capacity * sizeof(LightCacheTile), MemoryTag::Game);
+	CTileMap::Free(&tilemap);
+	SFree(SAllocator::Malloc, chunks, chunksSize, MemoryTag::Game);
+	return passed;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Core.h"
+#include "Vector2i.h"
+
+struct ChunkedTileMap;
+
+#define LIGHT_TRACER_ROWS_PER_JOB 8 // Screen rows each job traces
+#define LIGHT_TRACER_MAX_WIDTH 512 // Screen width in tiles the per row accumulators fit
+
+// light_tracer.comp's Light
+struct LightTracerLight
+{
+	Vector2 Pos;
+	float Radius;
+	Color Color;
+};
+
+// CPU version of light_tracer.comp. Every tile within a light's radius gets
+// color * 1 / (1 + a * d + b * d^2) and full alpha, summed over lights in floats and
+// saturating added into colors. Tiles in chunks that are not loaded stay unlit, the
+// shader's worldMap alpha test. Nothing occludes the lights, unlike shadowcasting.
+void LightTracerDraw(const LightTracerLight* lights, uint32_t count, ChunkedTileMap* tilemap,
+	Color* colors, Vector2i viewMin, Vector2i resolution);
+
+int TestLightTracer();
@@ -4,10 +4,29 @@
 #include "Vector2i.h"
 #include "SMemory.h"
 #include "SUtil.h"
+#include "FloodLighting.h"
 
 #include "Structures/StaticArray.h"
 #include "Structures/SList.h"
 #include "Structures/IndexArray.h"
+#include "Structures/SHashMap.h"
+
+#define LIGHT_UPDATE_THREADS 2
+#define LIGHT_GRID_SHIFT 5 // Light grid cells are 32x32 tiles
+#define LIGHT_GRID_MAX_RADIUS 64 // Grid cells searched around the view are padded by this
+#define PLAYER_FOV_RADIUS 40
+#define LIGHT_ATTENUATION_SHIFT 15 // Attenuation tables are fixed point, 1.0 is 1 << 15
+#define LIGHT_ATTENUATION_SIZE (LIGHT_GRID_MAX_RADIUS * LIGHT_GRID_MAX_RADIUS + 1) // Indexed by squared distance
+#define LIGHT_LOD_MERGE_SHIFT 2 // Lights with the same palette in a 4x4 tile cell merge into one
+#define LIGHT_LOD_SMALL_RADIUS 3 // Lights up to this max radius use the 3x3 static kernel
+#define LIGHT_LOD_FAR_DISTANCE 48 // Lights further than this from the player use the 3x3 static kernel
+#define LIGHT_LOD_COST_BUDGET (64 * 1024) // Tiles lit per frame before the farthest lights are downgraded
+#define LIGHT_LOD_STATIC_COST 9
+#define LIGHT_REBUILD_BUDGET_MS 1.0 // Visibility cache rebuilds per frame, other stale caches are drawn as they are
+#define LIGHT_MAX_STALE_FRAMES 8 // A stale visibility cache is rebuilt at most this many frames late
+#define LIGHT_ID_FLOOD_BIT (1u << 31) // Set in LightAdd() ids of flood lights, clear for updating lights
+#define PLAYER_FOV_SIDE (PLAYER_FOV_RADIUS * 2 + 1)
+#define PLAYER_FOV_WORDS ((PLAYER_FOV_SIDE + 63) / 64)
 
 struct GameApplication;
 struct Game;
@@ -21,8 +40,29 @@ typedef void(*LightUpdate)(Light* light, Game* game, float dt);
 
 enum class LightType : uint8_t
 {
-    Updating = 0,
-    Static
+    Updating = 0,   // Shadowcast from its own visibility cache
+    Static,
+    Flood           // Spread with every other flood light, see FloodLighting.h
+};
+
+// Attenuation 1 / (1 + A * d + B * d^2), see LightFalloffProfiles
+enum class LightFalloff : uint8_t
+{
+    Quadratic = 0,
+
+    MaxTypes
+};
+
+struct LightFalloffProfile
+{
+    float A;
+    float B;
+};
+
+// https://www.desmos.com/calculator/nmnaud1hrw
+constexpr global_var LightFalloffProfile LightFalloffProfiles[(size_t)LightFalloff::MaxTypes] =
+{
+    { 0.0f, 0.1f },
 };
 
 struct Light
@@ -34,6 +74,27 @@ struct Light
     LightType LightType;
 };
 
+struct LightCacheTile
+{
+    int16_t x;              // Offset from LightVisibilityCache::Pos
+    int16_t y;
+    uint16_t DistanceSqr;   // Index into the light's attenuation table
+};
+
+// Tiles an UpdatingLight can see at MaxIntensity, sorted by distance. Flicker only
+// lowers the radius, so every frame reuses the prefix within Radius. Rebuilt when
+// the light moves, a chunk in range loads or unloads, or a tile in range changes solidity.
+struct LightVisibilityCache
+{
+    LightCacheTile* Tiles;
+    Vector2i Pos;
+    uint32_t Count;
+    uint32_t Capacity;
+    int Radius;
+    uint16_t StaleFrames;       // Frames drawn stale while the scheduler deferred the rebuild
+    bool IsValid;
+};
+
 struct UpdatingLight : public Light
 {
     constexpr static float UPDATE_RATE = 0.2f;
@@ -43,7 +104,12 @@ struct UpdatingLight : public Light
     float MaxIntensity;     // Max Radius - Set to 0 to always use Min Radius
     float LastUpdate;       // Keeps track of internal update
     uint32_t EntityId;      // Entity to sync positions with, ENTITY_NO_POS to disable
+    uint32_t RandomId;      // Set when added, counter random stream of this light
+    uint32_t FlickerCount;  // Counter random draws so far
     bool UseMultiColor;     // If false uses Color[0] only
+    LightFalloff Falloff;
+    Vector2i GridCell;      // LightingState::LightGrid cell the light is in
+    LightVisibilityCache Cache;
 };
 
 struct StaticLightType
@@ -68,25 +134,87 @@ struct StaticLight : public Light
     StaticLightTypes StaticLightType;
 };
 
+// An updating light drawn this frame
+struct VisibleLight
+{
+    UpdatingLight* Light;
+    uint32_t Cost;          // Tiles the light is estimated to touch
+    uint16_t Intensity;     // Lights merged into this one by the LOD pass, including itself
+    bool UseStaticKernel;   // Drawn with the 3x3 static kernel instead of its visibility cache
+    bool Rebuild;           // Rebuilds its visibility cache before drawing, set by the scheduler
+};
+
+// Spends a time budget per frame on visibility cache rebuilds, costs are
+// estimated per cache tile and averaged over the frames that rebuilt
+struct LightRebuildScheduler
+{
+    double Budget;          // Seconds per frame on each light thread
+    double TileCost;        // Seconds per cache tile rebuilt
+    uint32_t Rebuilt;       // Last frame
+    uint32_t Deferred;
+};
+
+// Last frame of the light LOD pass, costs are estimated tiles touched
+struct LightLodStats
+{
+    uint32_t Lights;        // Visible lights before LOD
+    uint32_t Merged;        // Lights folded into another light of their cell
+    uint32_t Downgraded;    // Lights drawn with the static kernel
+    uint32_t CostBefore;
+    uint32_t CostAfter;
+};
+
+// Player FOV around Origin, bit x of Rows[y] is tile Origin + (x, y) - PLAYER_FOV_RADIUS.
+// Reused until the player moves or turns, chunks load or unload, or
+// a tile in range changes solidity.
+struct PlayerFovCache
+{
+    uint64_t Rows[PLAYER_FOV_SIDE][PLAYER_FOV_WORDS];
+    Vector2i Origin;
+    uint64_t JournalStamp;      // CTileMap::JournalStamp() when built
+    uint32_t ChunksVersion;     // ChunkedTileMap::ChunksVersion when built
+    uint8_t LookDir;
+    bool UseRowMask;
+    bool IsValid;
+};
+
 struct LightingState
 {
     constexpr static size_t UpdatingLightSize = AlignPowTwo64Ceil(sizeof(UpdatingLight) * 64);
 
     IndexArray<Light*> LightPtrs;
+    SHashMap<Vector2i, SList<uint32_t>> LightGrid;  // Light ids by grid cell, empty cells are removed
+    SList<uint32_t> EntityLights;                   // Light ids following an entity
     MemoryPool<UpdatingLight, UpdatingLightSize> UpdatingLightPool;
 
     StaticArray<StaticLightType, (size_t)StaticLightTypes::MaxTypes> StaticLightTypes;
 
+    Color* ThreadColors[LIGHT_UPDATE_THREADS];  // Screen sized, reused every frame, zeroed by the merge
+    uint32_t ThreadColorsCount;                 // Tiles per buffer
+
+    PlayerFovCache PlayerFov;
+    FloodLightState FloodLights;
+    LightLodStats LodStats;
+    LightRebuildScheduler RebuildScheduler;
+
     uint32_t NumOfUpdatingLights;
 };
 
-void LightsInitialize(LightingState* lightingState);
+void LightsInitialize(LightingState* lightingState, ChunkedTileMap* tilemap);
 uint32_t LightAddUpdating(LightingState* lightState, UpdatingLight* light);
+// Adds with the engine light->LightType picks, the id tells LightRemove() which one
+uint32_t LightAdd(LightingState* lightState, ChunkedTileMap* tilemap, Light* light);
 uint32_t GetNumOfLights();
-void LightRemove(LightingState* lightState, uint32_t lightId);
+void LightRemove(LightingState* lightState, ChunkedTileMap* tilemap, uint32_t lightId);
 void StaticLightDrawToChunk(StaticLight* light, TileMapChunk* chunkDst, ChunkedTileMap* tilemap);
 void LightsUpdate(LightingState* lightingState, Game* game);
 
+int TestRowMaskFov();
+int TestPlayerFovCache();
+int TestLightLod();
+int TestLightRebuildScheduler();
+int TestLightTileChanges();
+
 // Types
 struct Slope
 {
@@ -133,3 +261,14 @@ constexpr global_var int TranslationTable[8][4] =
     {  0,  1,  1,  0 },
     {  1,  0,  0,  1 },
 };
+
+// TranslationTable row as a template argument, so octant kernels fold it into their adds
+template<int Octant>
+_FORCE_INLINE_ Vector2i OctantTransform(int x, int y)
+{
+    static_assert(Octant >= 0 && Octant < 8, "8 octants");
+    return {
+        x * TranslationTable[Octant][0] + y * TranslationTable[Octant][1],
+        x * TranslationTable[Octant][2] + y * TranslationTable[Octant][3]
+    };
+}
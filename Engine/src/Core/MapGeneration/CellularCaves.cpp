@@ -0,0 +1,206 @@
+#include "CellularCaves.h"
+
+#include "Core/SMemory.h"
+#include "Core/SRandom.h"
+
+// 128 tiles of a region row, bit i is tile i
+struct CaveRow
+{
+	uint64_t Lo;
+	uint64_t Hi;
+};
+
+constexpr global_var uint32_t CAVE_FILL_THRESHOLD = (uint32_t)(0x100000000ull * CAVE_FILL_PERCENT / 100);
+
+internal _FORCE_INLINE_ bool
+CaveFill(uint64_t key, int x, int y)
+{
+	return SRandCounter32(key, SRandTileCounter(x, y)) < CAVE_FILL_THRESHOLD;
+}
+
+internal _FORCE_INLINE_ CaveRow
+ShiftUp(CaveRow r)
+{
+	return { r.Lo << 1, (r.Hi << 1) | (r.Lo >> 63) };
+}
+
+internal _FORCE_INLINE_ CaveRow
+ShiftDown(CaveRow r)
+{
+	return { (r.Lo >> 1) | (r.Hi << 63), r.Hi >> 1 };
+}
+
+// Bit sliced adders, every bit position is an independent cell
+internal _FORCE_INLINE_ void
+FullAdd(uint64_t a, uint64_t b, uint64_t c, uint64_t* sum, uint64_t* carry)
+{
+	uint64_t ab = a ^ b;
+	*sum = ab ^ c;
+	*carry = (a & b) | (ab & c);
+}
+
+// Counts the 8 neighbors of 64 cells at once and applies the B5678/S45678 rule
+internal _FORCE_INLINE_ uint64_t
+StepCells(uint64_t upL, uint64_t up, uint64_t upR,
+	uint64_t midL, uint64_t mid, uint64_t midR,
+	uint64_t downL, uint64_t down, uint64_t downR)
+{
+	// 2 bit counts of the row above (0-3), row below (0-3) and left/right (0-2)
+	uint64_t a0, a1, b0, b1;
+	FullAdd(upL, up, upR, &a0, &a1);
+	FullAdd(downL, down, downR, &b0, &b1);
+	uint64_t c0 = midL ^ midR;
+	uint64_t c1 = midL & midR;
+
+	// count = s3 s2 s1 s0
+	uint64_t s0, k0, t, k1;
+	FullAdd(a0, b0, c0, &s0, &k0);
+	FullAdd(a1, b1, c1, &t, &k1);
+	uint64_t s1 = t ^ k0;
+	uint64_t k2 = t & k0;
+	uint64_t s2 = k1 ^ k2;
+	uint64_t s3 = k1 & k2;
+
+	uint64_t atLeast5 = s3 | (s2 & (s1 | s0));
+	uint64_t exactly4 = ~s3 & s2 & ~s1 & ~s0;
+	return atLeast5 | (exactly4 & mid);
+}
+
+void CaveGenerateMask(int seed, ChunkCoord chunkCoord, uint64_t solid[CHUNK_DIMENSIONS])
+{
+	constexpr int apron = CAVE_ITERATIONS;
+	constexpr int dim = CAVE_REGION_DIMENSIONS;
+
+	CaveRow buffers[2][dim];
+	CaveRow* cur = buffers[0];
+	CaveRow* next = buffers[1];
+
+	uint64_t key = SRandCounterKey((uint64_t)seed, RandPurpose::CaveFill);
+	int startX = chunkCoord.x * CHUNK_DIMENSIONS - apron;
+	int startY = chunkCoord.y * CHUNK_DIMENSIONS - apron;
+	for (int y = 0; y < dim; ++y)
+	{
+		uint64_t lo = 0;
+		uint64_t hi = 0;
+		for (int x = 0; x < dim; ++x)
+		{
+			uint64_t bit = (uint64_t)CaveFill(key, startX + x, startY + y);
+			if (x < 64)
+				lo |= bit << x;
+			else
+				hi |= bit << (x - 64);
+		}
+		cur[y] = { lo, hi };
+	}
+
+	// Cells outside the region are treated as empty, the wrong values
+	// creep 1 tile inwards every iteration but never reach the chunk.
+	for (int i = 0; i < CAVE_ITERATIONS; ++i)
+	{
+		next[0] = cur[0];
+		next[dim - 1] = cur[dim - 1];
+		for (int y = 1; y < dim - 1; ++y)
+		{
+			CaveRow up = cur[y - 1];
+			CaveRow mid = cur[y];
+			CaveRow down = cur[y + 1];
+			CaveRow upL = ShiftUp(up), upR = ShiftDown(up);
+			CaveRow midL = ShiftUp(mid), midR = ShiftDown(mid);
+			CaveRow downL = ShiftUp(down), downR = ShiftDown(down);
+
+			next[y].Lo = StepCells(upL.Lo, up.Lo, upR.Lo, midL.Lo, mid.Lo, midR.Lo, downL.Lo, down.Lo, downR.Lo);
+			next[y].Hi = StepCells(upL.Hi, up.Hi, upR.Hi, midL.Hi, mid.Hi, midR.Hi, downL.Hi, down.Hi, downR.Hi);
+		}
+
+		CaveRow* tmp = cur;
+		cur = next;
+		next = tmp;
+	}
+
+	for (int y = 0; y < CHUNK_DIMENSIONS; ++y)
+	{
+		CaveRow row = cur[y + apron];
+		solid[y] = (row.Lo >> apron) | (row.Hi << (64 - apron));
+	}
+}
+
+// Runs the automaton one cell at a time over any rect, the fast path has to match it
+internal void
+CaveGenerateReference(int seed, Vector2i start, int width, int height, uint8_t* cells)
+{
+	uint8_t* scratch = (uint8_t*)SAlloc(SAllocator::Temp, (size_t)width * height, MemoryTag::Game);
+	uint64_t key = SRandCounterKey((uint64_t)seed, RandPurpose::CaveFill);
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+			cells[x + y * width] = (uint8_t)CaveFill(key, start.x + x, start.y + y);
+	}
+
+	for (int i = 0; i < CAVE_ITERATIONS; ++i)
+	{
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				int count = 0;
+				for (int oy = -1; oy <= 1; ++oy)
+				{
+					for (int ox = -1; ox <= 1; ++ox)
+					{
+						int nx = x + ox;
+						int ny = y + oy;
+						if ((ox || oy) && nx >= 0 && ny >= 0 && nx < width && ny < height)
+							count += cells[nx + ny * width];
+					}
+				}
+				uint8_t alive = cells[x + y * width];
+				scratch[x + y * width] = (uint8_t)(count >= 5 || (count == 4 && alive));
+			}
+		}
+		SMemCopy(cells, scratch, (size_t)width * height);
+	}
+}
+
+int TestCellularCaves()
+{
+	constexpr int seed = 1337;
+
+	// One region spanning a 2x2 block of chunks, they have to agree with it at the seams
+	const ChunkCoord origins[] = { { 0, 0 }, { -1, -1 }, { 5000, -12000 } };
+	constexpr int width = CHUNK_DIMENSIONS * 2 + CAVE_ITERATIONS * 2;
+	uint8_t* cells = (uint8_t*)SAlloc(SAllocator::Temp, width * width, MemoryTag::Game);
+
+	for (int o = 0; o < ArrayLength(origins); ++o)
+	{
+		ChunkCoord origin = origins[o];
+		Vector2i start = { origin.x * CHUNK_DIMENSIONS - CAVE_ITERATIONS, origin.y * CHUNK_DIMENSIONS - CAVE_ITERATIONS };
+		CaveGenerateReference(seed, start, width, width, cells);
+
+		for (int c = 0; c < 4; ++c)
+		{
+			ChunkCoord chunkCoord = { origin.x + (c & 1), origin.y + (c >> 1) };
+			uint64_t solid[CHUNK_DIMENSIONS];
+			CaveGenerateMask(seed, chunkCoord, solid);
+
+			for (int y = 0; y < CHUNK_DIMENSIONS; ++y)
+			{
+				for (int x = 0; x < CHUNK_DIMENSIONS; ++x)
+				{
+					int rx = x + (c & 1) * CHUNK_DIMENSIONS + CAVE_ITERATIONS;
+					int ry = y + (c >> 1) * CHUNK_DIMENSIONS + CAVE_ITERATIONS;
+					bool expected = cells[rx + ry * width];
+					bool actual = (solid[y] >> x) & 1;
+					if (expected != actual)
+					{
+						SLOG_ERR("[ Caves ] Mismatch in chunk (%d, %d) at (%d, %d)",
+							chunkCoord.x, chunkCoord.y, x, y);
+						return 0;
+					}
+				}
+			}
+		}
+	}
+
+	SLOG_INFO("[ Caves ] Chunk cave masks match a %dx%d reference region", width, width);
+	return 1;
+}
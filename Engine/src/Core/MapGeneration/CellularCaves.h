@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Core/Core.h"
+#include "Core/Vector2i.h"
+
+// Cave walls come from a cellular automaton (solid if 5+ of 8 neighbors are
+// solid, or 4 and already solid) run over random fill. Each iteration can
+// only see 1 tile further, so a chunk is evaluated with an apron of
+// CAVE_ITERATIONS tiles of fill around it. Fill is counter based random per tile,
+// the result never depends on neighboring chunks being loaded or their order.
+constexpr global_var int CAVE_ITERATIONS = 4;
+constexpr global_var int CAVE_FILL_PERCENT = 45;
+constexpr global_var int CAVE_REGION_DIMENSIONS = CHUNK_DIMENSIONS + CAVE_ITERATIONS * 2;
+static_assert(CHUNK_DIMENSIONS == 64, "Cave masks store a chunk row in a uint64_t");
+static_assert(CAVE_ITERATIONS > 0 && CAVE_REGION_DIMENSIONS <= 128, "Cave region rows are 128 bits");
+
+// Bit x of solid[y] is set if tile (x, y) of the chunk is a cave wall
+void CaveGenerateMask(int seed, ChunkCoord chunkCoord, uint64_t solid[CHUNK_DIMENSIONS]);
+
+int TestCellularCaves();
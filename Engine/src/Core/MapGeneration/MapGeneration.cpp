@@ -1,17 +1,179 @@
+#include <chrono>
+
 #include "MapGeneration.h"
+#include "NoiseBatch.h"
+#include "CellularCaves.h"
 
 #include "Core/Game.h"
 #include "Core/ChunkedTileMap.h"
 
 void MapGenInitialize(MapGenerator* generator, int seed)
 {
+	generator->Seed = seed;
+	generator->Frequency = 0.01f;
+	generator->HeightOctaves = 3;
+	generator->ClimateFrequency = 0.002f;
 	generator->Noise.SetSeed(seed);
+	generator->Noise.SetFrequency(generator->Frequency);
 	generator->Noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
 }
 
+void MapGenFree(MapGenerator* generator)
+{
+	if (!generator->ClimateRegions.IsAllocated())
+		return;
+
+	for (uint32_t i = 0; i < generator->ClimateRegions.Capacity; ++i)
+	{
+		ClimateRegion** region = generator->ClimateRegions.Index(i);
+		if (region)
+			SFree(SAllocator::Game, *region, sizeof(ClimateRegion), MemoryTag::Game);
+	}
+	generator->ClimateRegions.Free();
+}
+
 global_var const TileSheetCoord TILE_IDS[] = { STONE_FLOOR, GOLD_ORE, DARK_STONE_FLOOR, ROCKY_WALL, LAVA_0 };
 
+internal _FORCE_INLINE_ void
+SetTile(TileData* tile, TileSheetCoord coord)
+{
+	tile->TexX = coord.x;
+	tile->TexY = coord.y;
+	tile->HasCeiling = false;
+	tile->Ununsed = 0;
+}
+
+internal _FORCE_INLINE_ TileSheetCoord
+SelectBiomeTile(const TileGenData* gen)
+{
+	if (gen->Solid)
+		return (gen->Height > 0.28f && gen->Rainfall < -0.2f) ? GOLD_ORE : ROCKY_WALL;
+	if (gen->Height < -0.4f)
+		return (gen->Temperature > 0.25f) ? LAVA_0 : DARK_STONE_FLOOR;
+	return (gen->Rainfall > 0.15f) ? DARK_STONE_FLOOR : STONE_FLOOR;
+}
+
+internal ClimateRegion*
+GetClimateRegion(MapGenerator* generator, Vector2i regionCoord)
+{
+	ClimateRegion** cached = generator->ClimateRegions.Get(&regionCoord);
+	if (cached)
+		return *cached;
+
+	ClimateRegion* region = (ClimateRegion*)SAlloc(SAllocator::Game, sizeof(ClimateRegion), MemoryTag::Game);
+	SASSERT(region);
+
+	constexpr int regionTiles = CLIMATE_REGION_CHUNKS * CHUNK_DIMENSIONS;
+	Vector2i startTile = { regionCoord.x * regionTiles, regionCoord.y * regionTiles };
+
+	float xs[CLIMATE_REGION_SAMPLES];
+	float ys[CLIMATE_REGION_SAMPLES];
+	for (int y = 0; y < CLIMATE_REGION_SAMPLES; ++y)
+	{
+		float* temperatureRow = &region->Temperature[y * CLIMATE_REGION_SAMPLES];
+		float* rainfallRow = &region->Rainfall[y * CLIMATE_REGION_SAMPLES];
+
+		for (int x = 0; x < CLIMATE_REGION_SAMPLES; ++x)
+		{
+			xs[x] = (float)(startTile.x + x * CLIMATE_CELL_TILES);
+			ys[x] = (float)(startTile.y + y * CLIMATE_CELL_TILES);
+		}
+		NoiseTransformCoords(generator->ClimateFrequency, xs, ys, CLIMATE_REGION_SAMPLES);
+		NoiseSimplex2(generator->Seed + 1, xs, ys, temperatureRow, CLIMATE_REGION_SAMPLES);
+		NoiseSimplex2(generator->Seed + 2, xs, ys, rainfallRow, CLIMATE_REGION_SAMPLES);
+	}
+
+	generator->ClimateRegions.Insert(&regionCoord, &region);
+	return region;
+}
+
+internal _FORCE_INLINE_ Vector2i
+ChunkToRegion(ChunkCoord chunkCoord)
+{
+	return { chunkCoord.x >> CLIMATE_REGION_CHUNKS_SHIFT, chunkCoord.y >> CLIMATE_REGION_CHUNKS_SHIFT };
+}
+
+// Bilinear upsample of a chunk's part of a region's lattice, one row at a time
+internal void
+UpsampleClimateRow(const float* samples, int cellX, int cellY, float fy, float* out)
+{
+	constexpr int chunkCells = CHUNK_DIMENSIONS / CLIMATE_CELL_TILES;
+	constexpr float invCell = 1.0f / (float)CLIMATE_CELL_TILES;
+
+	// Interpolate vertically once per lattice column
+	float column[chunkCells + 1];
+	for (int i = 0; i <= chunkCells; ++i)
+	{
+		float top = samples[(cellX + i) + cellY * CLIMATE_REGION_SAMPLES];
+		float bottom = samples[(cellX + i) + (cellY + 1) * CLIMATE_REGION_SAMPLES];
+		column[i] = top + (bottom - top) * fy;
+	}
+
+	for (int x = 0; x < CHUNK_DIMENSIONS; ++x)
+	{
+		int cell = x / CLIMATE_CELL_TILES;
+		float fx = (float)(x % CLIMATE_CELL_TILES) * invCell;
+		out[x] = column[cell] + (column[cell + 1] - column[cell]) * fx;
+	}
+}
+
 void MapGenGenerateChunk(MapGenerator* generator, ChunkedTileMap* tilemap, TileMapChunk* chunk)
+{
+	MapGenGenerateTiles(generator, chunk->ChunkCoord, chunk->Tiles.Data);
+}
+
+void MapGenGenerateTiles(MapGenerator* generator, ChunkCoord chunkCoord, TileData* tiles)
+{
+	constexpr int chunkCells = CHUNK_DIMENSIONS / CLIMATE_CELL_TILES;
+	constexpr float invCell = 1.0f / (float)CLIMATE_CELL_TILES;
+
+	float height[CHUNK_SIZE];
+	NoiseFBm2Chunk(generator->Seed, generator->Frequency, generator->HeightOctaves,
+		2.0f, 0.5f, chunkCoord, height);
+
+	uint64_t solid[CHUNK_DIMENSIONS];
+	CaveGenerateMask(generator->Seed, chunkCoord, solid);
+
+	const ClimateRegion* region = GetClimateRegion(generator, ChunkToRegion(chunkCoord));
+	int cellX = (chunkCoord.x & (CLIMATE_REGION_CHUNKS - 1)) * chunkCells;
+	int cellY = (chunkCoord.y & (CLIMATE_REGION_CHUNKS - 1)) * chunkCells;
+
+	float temperature[CHUNK_DIMENSIONS];
+	float rainfall[CHUNK_DIMENSIONS];
+	for (int y = 0; y < CHUNK_DIMENSIONS; ++y)
+	{
+		int rowCellY = cellY + y / CLIMATE_CELL_TILES;
+		float fy = (float)(y % CLIMATE_CELL_TILES) * invCell;
+		UpsampleClimateRow(region->Temperature, cellX, rowCellY, fy, temperature);
+		UpsampleClimateRow(region->Rainfall, cellX, rowCellY, fy, rainfall);
+
+		for (int x = 0; x < CHUNK_DIMENSIONS; ++x)
+		{
+			int idx = x + y * CHUNK_DIMENSIONS;
+			TileGenData gen;
+			gen.Height = height[idx];
+			gen.Temperature = temperature[x];
+			gen.Rainfall = rainfall[x];
+			gen.Solid = (solid[y] >> x) & 1;
+			SetTile(&tiles[idx], SelectBiomeTile(&gen));
+		}
+	}
+}
+
+void MapGenPrewarmRegions(MapGenerator* generator, ChunkCoord startChunk, ChunkCoord endChunk)
+{
+	Vector2i startRegion = ChunkToRegion(startChunk);
+	Vector2i endRegion = ChunkToRegion(endChunk);
+	for (int y = startRegion.y; y <= endRegion.y; ++y)
+	{
+		for (int x = startRegion.x; x <= endRegion.x; ++x)
+		{
+			GetClimateRegion(generator, { x, y });
+		}
+	}
+}
+
+void MapGenGenerateChunkBaseline(MapGenerator* generator, ChunkedTileMap* tilemap, TileMapChunk* chunk)
 {
 	int idx = 0;
 	for (int y = 0; y < CHUNK_DIMENSIONS; ++y)
@@ -27,12 +189,49 @@ void MapGenGenerateChunk(MapGenerator* generator, ChunkedTileMap* tilemap, TileM
 			if (tileTableIndex == ArrayLength(TILE_IDS)) 
 				tileTableIndex = ArrayLength(TILE_IDS) - 1;
 
-			TileSheetCoord coord = TILE_IDS[tileTableIndex];
-			chunk->Tiles[idx].TexX = coord.x;
-			chunk->Tiles[idx].TexY = coord.y;
-			chunk->Tiles[idx].HasCeiling = false;
-			chunk->Tiles[idx].Ununsed = 0;
+			SetTile(&chunk->Tiles[idx], TILE_IDS[tileTableIndex]);
 			++idx;
 		}
 	}
-}
\ No newline at end of file
+}
+
+// raylib's GetTime() needs a window, the benchmark runs from WorldGen
+internal double
+GetBenchmarkTime()
+{
+	using namespace std::chrono;
+	return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+void MapGenBenchmark(MapGenerator* generator, int chunkCount)
+{
+	SASSERT(chunkCount > 0);
+
+	constexpr size_t chunkSize = sizeof(TileMapChunk);
+	TileMapChunk* chunk = (TileMapChunk*)SAlloc(SAllocator::Game, chunkSize, MemoryTag::Game);
+	SMemClear(chunk, chunkSize);
+
+	int side = (int)ceilf(sqrtf((float)chunkCount));
+	ChunkCoord start = { -side / 2, -side / 2 };
+
+	double baselineTime = 0.0;
+	double biomeTime = 0.0;
+	for (int i = 0; i < chunkCount; ++i)
+	{
+		chunk->ChunkCoord = { start.x + i % side, start.y + i / side };
+
+		double time = GetBenchmarkTime();
+		MapGenGenerateChunkBaseline(generator, nullptr, chunk);
+		baselineTime += GetBenchmarkTime() - time;
+
+		time = GetBenchmarkTime();
+		MapGenGenerateChunk(generator, nullptr, chunk);
+		biomeTime += GetBenchmarkTime() - time;
+	}
+
+	SLOG_INFO("[ MapGen ] Generated %d chunks. Baseline: %.0f chunks/s, Biome (%s): %.0f chunks/s, %u climate regions",
+		chunkCount, (double)chunkCount / baselineTime, NoiseInstructionSet(),
+		(double)chunkCount / biomeTime, generator->ClimateRegions.Size);
+
+	SFree(SAllocator::Game, chunk, chunkSize, MemoryTag::Game);
+}
@@ -1,24 +1,67 @@
 #pragma once
 
 #include "Core/Core.h"
+#include "Core/Vector2i.h"
+
+#include "Core/Structures/SHashMap.h"
 
 #include "FastNoiseLite/FastNoiseLite.h"
 
 struct ChunkedTileMap;
 struct TileMapChunk;
+struct TileData;
 
 struct TileGenData
 {
 	float Height;
 	float Temperature;
 	float Rainfall;
+	bool Solid;		// Cave wall
+};
+
+// Temperature and rainfall change slowly, so they are sampled on a coarse
+// lattice once per region and bilinearly upsampled per tile.
+constexpr global_var int CLIMATE_CELL_TILES = 16;
+constexpr global_var int CLIMATE_REGION_CHUNKS = 4;
+constexpr global_var int CLIMATE_REGION_CHUNKS_SHIFT = 2;
+constexpr global_var int CLIMATE_REGION_CELLS = CLIMATE_REGION_CHUNKS * CHUNK_DIMENSIONS / CLIMATE_CELL_TILES;
+constexpr global_var int CLIMATE_REGION_SAMPLES = CLIMATE_REGION_CELLS + 1;
+static_assert((1 << CLIMATE_REGION_CHUNKS_SHIFT) == CLIMATE_REGION_CHUNKS, "CLIMATE_REGION_CHUNKS must be a power of 2");
+static_assert(CHUNK_DIMENSIONS % CLIMATE_CELL_TILES == 0, "Chunks must be made of whole climate cells");
+
+struct ClimateRegion
+{
+	float Temperature[CLIMATE_REGION_SAMPLES * CLIMATE_REGION_SAMPLES];
+	float Rainfall[CLIMATE_REGION_SAMPLES * CLIMATE_REGION_SAMPLES];
 };
 
 struct MapGenerator
 {
 	FastNoiseLite Noise;
+	SHashMap<Vector2i, ClimateRegion*> ClimateRegions;
+	int Seed;
+	float Frequency;
+	int HeightOctaves;
+	float ClimateFrequency;
 };
 
 void MapGenInitialize(MapGenerator* generator, int seed);
+void MapGenFree(MapGenerator* generator);
 
+// Not thread safe, can insert into ClimateRegions. Use MapGenPrewarmRegions()
+// before generating chunks from multiple threads.
 void MapGenGenerateChunk(MapGenerator* generator, ChunkedTileMap* tilemap, TileMapChunk* chunk);
+
+// Writes CHUNK_SIZE tiles of a chunk. Only reads the generator if the
+// chunk's climate region was prewarmed, safe to call from jobs then.
+void MapGenGenerateTiles(MapGenerator* generator, ChunkCoord chunkCoord, TileData* tiles);
+
+// Computes climate regions for chunks in [startChunk, endChunk]
+void MapGenPrewarmRegions(MapGenerator* generator, ChunkCoord startChunk, ChunkCoord endChunk);
+
+// Original single field, per tile FastNoiseLite generator.
+// Kept as a baseline for MapGenBenchmark().
+void MapGenGenerateChunkBaseline(MapGenerator* generator, ChunkedTileMap* tilemap, TileMapChunk* chunk);
+
+// Logs chunks/sec of the baseline and biome generators, run by WorldGen -bench
+void MapGenBenchmark(MapGenerator* generator, int chunkCount);
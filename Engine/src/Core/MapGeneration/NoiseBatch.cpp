@@ -0,0 +1,468 @@
+#include "NoiseBatch.h"
+
+#include "Core/SMemory.h"
+
+#include "FastNoiseLite/FastNoiseLite.h"
+
+#if defined(__AVX2__)
+	#define NOISE_AVX2 1
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define NOISE_SSE2 1
+	#include <emmintrin.h>
+#endif
+
+// Copy of FastNoiseLite::Lookup<float>::Gradients2D, which is private
+global_var const float Gradients2D[] =
+{
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.38268343236509f, 0.923879532511287f, 0.923879532511287f, 0.38268343236509f, 0.923879532511287f, -0.38268343236509f, 0.38268343236509f, -0.923879532511287f,
+	-0.38268343236509f, -0.923879532511287f, -0.923879532511287f, -0.38268343236509f, -0.923879532511287f, 0.38268343236509f, -0.38268343236509f, 0.923879532511287f,
+};
+
+// Same expressions as FastNoiseLite so constants round the same
+constexpr global_var float SQRT3 = 1.7320508075688772935274463415059f;
+constexpr global_var float F2 = 0.5f * (SQRT3 - 1);
+constexpr global_var float G2 = (3 - SQRT3) / 6;
+constexpr global_var float C_T = (float)(2 * (1 - 2 * G2) * (1 / G2 - 2));
+constexpr global_var float C_A = (float)(-2 * (1 - 2 * G2) * (1 - 2 * G2));
+constexpr global_var float G2_2M1 = 2 * (float)G2 - 1;
+constexpr global_var float G2_M1 = (float)G2 - 1;
+constexpr global_var float NOISE_SCALE = 99.83685446303647f;
+constexpr global_var int PRIME_X = 501125321;
+constexpr global_var int PRIME_Y = 1136930381;
+constexpr global_var int HASH_MUL = 0x27d4eb2d;
+
+internal _FORCE_INLINE_ int
+FastFloor(float f)
+{
+	return f >= 0 ? (int)f : (int)f - 1;
+}
+
+internal _FORCE_INLINE_ float
+GradCoord(int seed, int xPrimed, int yPrimed, float xd, float yd)
+{
+	int hash = seed ^ xPrimed ^ yPrimed;
+	hash *= HASH_MUL;
+	hash ^= hash >> 15;
+	hash &= 127 << 1;
+	return xd * Gradients2D[hash] + yd * Gradients2D[hash | 1];
+}
+
+internal float
+SingleSimplex(int seed, float x, float y)
+{
+	int i = FastFloor(x);
+	int j = FastFloor(y);
+	float xi = (float)(x - i);
+	float yi = (float)(y - j);
+
+	float t = (xi + yi) * G2;
+	float x0 = (float)(xi - t);
+	float y0 = (float)(yi - t);
+
+	i *= PRIME_X;
+	j *= PRIME_Y;
+
+	float n0, n1, n2;
+
+	float a = 0.5f - x0 * x0 - y0 * y0;
+	if (a <= 0) n0 = 0;
+	else n0 = (a * a) * (a * a) * GradCoord(seed, i, j, x0, y0);
+
+	float c = C_T * t + (C_A + a);
+	if (c <= 0) n2 = 0;
+	else n2 = (c * c) * (c * c) * GradCoord(seed, i + PRIME_X, j + PRIME_Y, x0 + G2_2M1, y0 + G2_2M1);
+
+	float x1, y1;
+	int i1, j1;
+	if (y0 > x0)
+	{
+		x1 = x0 + G2;
+		y1 = y0 + G2_M1;
+		i1 = i;
+		j1 = j + PRIME_Y;
+	}
+	else
+	{
+		x1 = x0 + G2_M1;
+		y1 = y0 + G2;
+		i1 = i + PRIME_X;
+		j1 = j;
+	}
+	float b = 0.5f - x1 * x1 - y1 * y1;
+	if (b <= 0) n1 = 0;
+	else n1 = (b * b) * (b * b) * GradCoord(seed, i1, j1, x1, y1);
+
+	return (n0 + n1 + n2) * NOISE_SCALE;
+}
+
+#if NOISE_AVX2
+
+constexpr global_var int NOISE_LANES = 8;
+
+internal _FORCE_INLINE_ __m256
+GradCoord8(__m256i seed, __m256i xPrimed, __m256i yPrimed, __m256 xd, __m256 yd)
+{
+	__m256i hash = _mm256_xor_si256(_mm256_xor_si256(seed, xPrimed), yPrimed);
+	hash = _mm256_mullo_epi32(hash, _mm256_set1_epi32(HASH_MUL));
+	hash = _mm256_xor_si256(hash, _mm256_srai_epi32(hash, 15));
+	hash = _mm256_and_si256(hash, _mm256_set1_epi32(127 << 1));
+
+	__m256 xg = _mm256_i32gather_ps(Gradients2D, hash, 4);
+	__m256 yg = _mm256_i32gather_ps(Gradients2D, _mm256_or_si256(hash, _mm256_set1_epi32(1)), 4);
+	return _mm256_add_ps(_mm256_mul_ps(xd, xg), _mm256_mul_ps(yd, yg));
+}
+
+internal _FORCE_INLINE_ __m256i
+FastFloor8(__m256 f)
+{
+	// Truncates then subtracts 1 from negatives, same as FastFloor()
+	__m256i i = _mm256_cvttps_epi32(f);
+	__m256 isNegative = _mm256_cmp_ps(f, _mm256_setzero_ps(), _CMP_LT_OQ);
+	return _mm256_add_epi32(i, _mm256_castps_si256(isNegative));
+}
+
+internal _FORCE_INLINE_ __m256
+Falloff8(__m256 v, __m256 grad)
+{
+	__m256 v2 = _mm256_mul_ps(v, v);
+	__m256 n = _mm256_mul_ps(_mm256_mul_ps(v2, v2), grad);
+	return _mm256_and_ps(n, _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_GT_OQ));
+}
+
+internal void
+Simplex8(int seedInt, const float* xs, const float* ys, float* out)
+{
+	const __m256i seed = _mm256_set1_epi32(seedInt);
+	const __m256i primeX = _mm256_set1_epi32(PRIME_X);
+	const __m256i primeY = _mm256_set1_epi32(PRIME_Y);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 g2 = _mm256_set1_ps(G2);
+	const __m256 g2m1 = _mm256_set1_ps(G2_M1);
+	const __m256 g22m1 = _mm256_set1_ps(G2_2M1);
+
+	__m256 x = _mm256_loadu_ps(xs);
+	__m256 y = _mm256_loadu_ps(ys);
+
+	__m256i i = FastFloor8(x);
+	__m256i j = FastFloor8(y);
+	__m256 xi = _mm256_sub_ps(x, _mm256_cvtepi32_ps(i));
+	__m256 yi = _mm256_sub_ps(y, _mm256_cvtepi32_ps(j));
+
+	__m256 t = _mm256_mul_ps(_mm256_add_ps(xi, yi), g2);
+	__m256 x0 = _mm256_sub_ps(xi, t);
+	__m256 y0 = _mm256_sub_ps(yi, t);
+
+	i = _mm256_mullo_epi32(i, primeX);
+	j = _mm256_mullo_epi32(j, primeY);
+
+	__m256 a = _mm256_sub_ps(_mm256_sub_ps(half, _mm256_mul_ps(x0, x0)), _mm256_mul_ps(y0, y0));
+	__m256 n0 = Falloff8(a, GradCoord8(seed, i, j, x0, y0));
+
+	__m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(C_T), t), _mm256_add_ps(_mm256_set1_ps(C_A), a));
+	__m256 n2 = Falloff8(c, GradCoord8(seed, _mm256_add_epi32(i, primeX), _mm256_add_epi32(j, primeY),
+		_mm256_add_ps(x0, g22m1), _mm256_add_ps(y0, g22m1)));
+
+	__m256 yGreater = _mm256_cmp_ps(y0, x0, _CMP_GT_OQ);
+	__m256i yGreaterInt = _mm256_castps_si256(yGreater);
+	__m256 x1 = _mm256_blendv_ps(_mm256_add_ps(x0, g2m1), _mm256_add_ps(x0, g2), yGreater);
+	__m256 y1 = _mm256_blendv_ps(_mm256_add_ps(y0, g2), _mm256_add_ps(y0, g2m1), yGreater);
+	__m256i i1 = _mm256_add_epi32(i, _mm256_andnot_si256(yGreaterInt, primeX));
+	__m256i j1 = _mm256_add_epi32(j, _mm256_and_si256(yGreaterInt, primeY));
+	__m256 b = _mm256_sub_ps(_mm256_sub_ps(half, _mm256_mul_ps(x1, x1)), _mm256_mul_ps(y1, y1));
+	__m256 n1 = Falloff8(b, GradCoord8(seed, i1, j1, x1, y1));
+
+	__m256 sum = _mm256_add_ps(_mm256_add_ps(n0, n1), n2);
+	_mm256_storeu_ps(out, _mm256_mul_ps(sum, _mm256_set1_ps(NOISE_SCALE)));
+}
+
+#define SimplexLanes Simplex8
+
+#elif NOISE_SSE2
+
+constexpr global_var int NOISE_LANES = 4;
+
+// SSE2 has no 32 bit low multiply
+internal _FORCE_INLINE_ __m128i
+MulLo4(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+internal _FORCE_INLINE_ __m128
+Select4(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+internal _FORCE_INLINE_ __m128
+GradCoord4(__m128i seed, __m128i xPrimed, __m128i yPrimed, __m128 xd, __m128 yd)
+{
+	__m128i hash = _mm_xor_si128(_mm_xor_si128(seed, xPrimed), yPrimed);
+	hash = MulLo4(hash, _mm_set1_epi32(HASH_MUL));
+	hash = _mm_xor_si128(hash, _mm_srai_epi32(hash, 15));
+	hash = _mm_and_si128(hash, _mm_set1_epi32(127 << 1));
+
+	alignas(16) int h[4];
+	_mm_store_si128((__m128i*)h, hash);
+	__m128 xg = _mm_setr_ps(Gradients2D[h[0]], Gradients2D[h[1]], Gradients2D[h[2]], Gradients2D[h[3]]);
+	__m128 yg = _mm_setr_ps(Gradients2D[h[0] | 1], Gradients2D[h[1] | 1], Gradients2D[h[2] | 1], Gradients2D[h[3] | 1]);
+	return _mm_add_ps(_mm_mul_ps(xd, xg), _mm_mul_ps(yd, yg));
+}
+
+internal _FORCE_INLINE_ __m128i
+FastFloor4(__m128 f)
+{
+	// Truncates then subtracts 1 from negatives, same as FastFloor()
+	__m128i i = _mm_cvttps_epi32(f);
+	__m128 isNegative = _mm_cmplt_ps(f, _mm_setzero_ps());
+	return _mm_add_epi32(i, _mm_castps_si128(isNegative));
+}
+
+internal _FORCE_INLINE_ __m128
+Falloff4(__m128 v, __m128 grad)
+{
+	__m128 v2 = _mm_mul_ps(v, v);
+	__m128 n = _mm_mul_ps(_mm_mul_ps(v2, v2), grad);
+	return _mm_and_ps(n, _mm_cmpgt_ps(v, _mm_setzero_ps()));
+}
+
+internal void
+Simplex4(int seedInt, const float* xs, const float* ys, float* out)
+{
+	const __m128i seed = _mm_set1_epi32(seedInt);
+	const __m128i primeX = _mm_set1_epi32(PRIME_X);
+	const __m128i primeY = _mm_set1_epi32(PRIME_Y);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 g2 = _mm_set1_ps(G2);
+	const __m128 g2m1 = _mm_set1_ps(G2_M1);
+	const __m128 g22m1 = _mm_set1_ps(G2_2M1);
+
+	__m128 x = _mm_loadu_ps(xs);
+	__m128 y = _mm_loadu_ps(ys);
+
+	__m128i i = FastFloor4(x);
+	__m128i j = FastFloor4(y);
+	__m128 xi = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+	__m128 yi = _mm_sub_ps(y, _mm_cvtepi32_ps(j));
+
+	__m128 t = _mm_mul_ps(_mm_add_ps(xi, yi), g2);
+	__m128 x0 = _mm_sub_ps(xi, t);
+	__m128 y0 = _mm_sub_ps(yi, t);
+
+	i = MulLo4(i, primeX);
+	j = MulLo4(j, primeY);
+
+	__m128 a = _mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0));
+	__m128 n0 = Falloff4(a, GradCoord4(seed, i, j, x0, y0));
+
+	__m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(C_T), t), _mm_add_ps(_mm_set1_ps(C_A), a));
+	__m128 n2 = Falloff4(c, GradCoord4(seed, _mm_add_epi32(i, primeX), _mm_add_epi32(j, primeY),
+		_mm_add_ps(x0, g22m1), _mm_add_ps(y0, g22m1)));
+
+	__m128 yGreater = _mm_cmpgt_ps(y0, x0);
+	__m128i yGreaterInt = _mm_castps_si128(yGreater);
+	__m128 x1 = Select4(yGreater, _mm_add_ps(x0, g2), _mm_add_ps(x0, g2m1));
+	__m128 y1 = Select4(yGreater, _mm_add_ps(y0, g2m1), _mm_add_ps(y0, g2));
+	__m128i i1 = _mm_add_epi32(i, _mm_andnot_si128(yGreaterInt, primeX));
+	__m128i j1 = _mm_add_epi32(j, _mm_and_si128(yGreaterInt, primeY));
+	__m128 b = _mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1));
+	__m128 n1 = Falloff4(b, GradCoord4(seed, i1, j1, x1, y1));
+
+	__m128 sum = _mm_add_ps(_mm_add_ps(n0, n1), n2);
+	_mm_storeu_ps(out, _mm_mul_ps(sum, _mm_set1_ps(NOISE_SCALE)));
+}
+
+#define SimplexLanes Simplex4
+
+#endif
+
+void NoiseTransformCoords(float frequency, float* xs, float* ys, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		float x = xs[i] * frequency;
+		float y = ys[i] * frequency;
+		float t = (x + y) * F2;
+		xs[i] = x + t;
+		ys[i] = y + t;
+	}
+}
+
+void NoiseSimplex2(int seed, const float* xs, const float* ys, float* out, int count)
+{
+	int i = 0;
+#ifdef SimplexLanes
+	for (; i + NOISE_LANES <= count; i += NOISE_LANES)
+	{
+		SimplexLanes(seed, xs + i, ys + i, out + i);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		out[i] = SingleSimplex(seed, xs[i], ys[i]);
+	}
+}
+
+void NoiseSimplex2Chunk(int seed, float frequency, ChunkCoord chunkCoord, float* out)
+{
+	float xs[CHUNK_DIMENSIONS];
+	float ys[CHUNK_DIMENSIONS];
+	for (int y = 0; y < CHUNK_DIMENSIONS; ++y)
+	{
+		// Same world coordinates as MapGenGenerateChunk() always used
+		for (int x = 0; x < CHUNK_DIMENSIONS; ++x)
+		{
+			xs[x] = (float)x + (float)chunkCoord.x * (float)CHUNK_DIMENSIONS;
+			ys[x] = (float)y + (float)chunkCoord.y * (float)CHUNK_DIMENSIONS;
+		}
+		NoiseTransformCoords(frequency, xs, ys, CHUNK_DIMENSIONS);
+		NoiseSimplex2(seed, xs, ys, out + y * CHUNK_DIMENSIONS, CHUNK_DIMENSIONS);
+	}
+}
+
+void NoiseFBm2(int seed, int octaves, float lacunarity, float gain, float* xs, float* ys, float* out, int count)
+{
+	SASSERT(octaves > 0);
+	SASSERT(count <= CHUNK_DIMENSIONS);
+
+	// Same as FastNoiseLite::CalculateFractalBounding()
+	float absGain = fabsf(gain);
+	float octaveAmp = absGain;
+	float ampFractal = 1.0f;
+	for (int i = 1; i < octaves; ++i)
+	{
+		ampFractal += octaveAmp;
+		octaveAmp *= absGain;
+	}
+	float amp = 1 / ampFractal;
+
+	float noise[CHUNK_DIMENSIONS];
+	for (int i = 0; i < count; ++i)
+		out[i] = 0;
+
+	for (int octave = 0; octave < octaves; ++octave)
+	{
+		NoiseSimplex2(seed++, xs, ys, noise, count);
+		for (int i = 0; i < count; ++i)
+		{
+			out[i] += noise[i] * amp;
+			xs[i] *= lacunarity;
+			ys[i] *= lacunarity;
+		}
+		amp *= gain;
+	}
+}
+
+void NoiseFBm2Chunk(int seed, float frequency, int octaves, float lacunarity, float gain, ChunkCoord chunkCoord, float* out)
+{
+	float xs[CHUNK_DIMENSIONS];
+	float ys[CHUNK_DIMENSIONS];
+	for (int y = 0; y < CHUNK_DIMENSIONS; ++y)
+	{
+		for (int x = 0; x < CHUNK_DIMENSIONS; ++x)
+		{
+			xs[x] = (float)x + (float)chunkCoord.x * (float)CHUNK_DIMENSIONS;
+			ys[x] = (float)y + (float)chunkCoord.y * (float)CHUNK_DIMENSIONS;
+		}
+		NoiseTransformCoords(frequency, xs, ys, CHUNK_DIMENSIONS);
+		NoiseFBm2(seed, octaves, lacunarity, gain, xs, ys, out + y * CHUNK_DIMENSIONS, CHUNK_DIMENSIONS);
+	}
+}
+
+const char* NoiseInstructionSet()
+{
+#if NOISE_AVX2
+	return "AVX2";
+#elif NOISE_SSE2
+	return "SSE2";
+#else
+	return "Scalar";
+#endif
+}
+
+int TestNoiseBatch()
+{
+	constexpr int seed = 1337;
+	constexpr float frequency = 0.01f;
+
+	FastNoiseLite noise;
+	noise.SetSeed(seed);
+	noise.SetFrequency(frequency);
+	noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+
+	FastNoiseLite fbm = noise;
+	fbm.SetFractalType(FastNoiseLite::FractalType_FBm);
+	fbm.SetFractalOctaves(4);
+
+	const ChunkCoord coords[] = { { 0, 0 }, { -1, -1 }, { 3, -7 }, { -250, 1000 }, { 40000, -40000 } };
+	float out[CHUNK_SIZE];
+	float outFBm[CHUNK_SIZE];
+	for (int c = 0; c < ArrayLength(coords); ++c)
+	{
+		NoiseSimplex2Chunk(seed, frequency, coords[c], out);
+		NoiseFBm2Chunk(seed, frequency, 4, 2.0f, 0.5f, coords[c], outFBm);
+
+		int idx = 0;
+		for (int y = 0; y < CHUNK_DIMENSIONS; ++y)
+		{
+			for (int x = 0; x < CHUNK_DIMENSIONS; ++x)
+			{
+				float worldX = (float)x + (float)coords[c].x * (float)CHUNK_DIMENSIONS;
+				float worldY = (float)y + (float)coords[c].y * (float)CHUNK_DIMENSIONS;
+				float expected = noise.GetNoise(worldX, worldY);
+				if (!SMemCompare(&expected, &out[idx], sizeof(float)))
+				{
+					SLOG_ERR("[ Noise ] Batched noise mismatch at (%f, %f): %f != %f",
+						worldX, worldY, out[idx], expected);
+					return 0;
+				}
+
+				float expectedFBm = fbm.GetNoise(worldX, worldY);
+				if (!SMemCompare(&expectedFBm, &outFBm[idx], sizeof(float)))
+				{
+					SLOG_ERR("[ Noise ] Batched FBm mismatch at (%f, %f): %f != %f",
+						worldX, worldY, outFBm[idx], expectedFBm);
+					return 0;
+				}
+				++idx;
+			}
+		}
+	}
+
+	SLOG_INFO("[ Noise ] Batched noise (%s) matches FastNoiseLite", NoiseInstructionSet());
+	return 1;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Core/Core.h"
+
+// Batched version of FastNoiseLite's 2D OpenSimplex2 noise (no fractal
+// or domain warp). Output is bit identical to FastNoiseLite::GetNoise(float, float)
+// as long as neither is compiled with floating point contraction (FMA).
+// Uses AVX2 if compiled with it, otherwise SSE2, with a scalar fallback.
+
+// Applies FastNoiseLite's frequency and OpenSimplex2 skew in place
+void NoiseTransformCoords(float frequency, float* xs, float* ys, int count);
+
+// Noise for coordinates already passed through NoiseTransformCoords()
+void NoiseSimplex2(int seed, const float* xs, const float* ys, float* out, int count);
+
+// Noise for every tile in chunk, out must hold CHUNK_SIZE floats
+void NoiseSimplex2Chunk(int seed, float frequency, ChunkCoord chunkCoord, float* out);
+
+// Fractal brownian motion of OpenSimplex2, same as FastNoiseLite's FractalType_FBm
+// with weighted strength 0. Scales xs and ys by lacunarity per octave.
+void NoiseFBm2(int seed, int octaves, float lacunarity, float gain, float* xs, float* ys, float* out, int count);
+void NoiseFBm2Chunk(int seed, float frequency, int octaves, float lacunarity, float gain, ChunkCoord chunkCoord, float* out);
+
+const char* NoiseInstructionSet();
+
+int TestNoiseBatch();
@@ -0,0 +1,163 @@
+#include "RowMaskFov.h"
+
+#include "ChunkedTileMap.h"
+#include "Lighting.h"
+#include "SUtil.h"
+
+// Bits lo to hi inclusive, empty if hi < lo
+internal _FORCE_INLINE_ uint64_t
+BitRange(int lo, int hi)
+{
+	if (hi < lo)
+		return 0;
+	uint64_t upper = (hi >= 63) ? ~0ull : ((1ull << (hi + 1)) - 1);
+	return upper & ~((1ull << lo) - 1);
+}
+
+// Solid bits of octant column x, bit y is tile (x, y)
+internal _FORCE_INLINE_ uint64_t
+SampleOctantColumn(TileSampler* sampler, Vector2i origin, uint8_t octant, int x, int count)
+{
+	const int* t = TranslationTable[octant];
+	TileCoord start = { origin.x + x * t[0], origin.y + x * t[2] };
+
+	// Octant x runs along world x, y walks a world column. Otherwise y walks a world row.
+	bool isColumn = t[0] != 0;
+	int step = (isColumn) ? t[3] : t[1];
+	if (step > 0)
+	{
+		return (isColumn) ? CTileMap::SampleSolidMask<false>(sampler, start, count)
+			: CTileMap::SampleSolidMask<true>(sampler, start, count);
+	}
+
+	// Sample the same tiles walking forwards, then flip so bit 0 is at the origin's side
+	uint64_t mask;
+	if (isColumn)
+		mask = CTileMap::SampleSolidMask<false>(sampler, { start.x, start.y - (count - 1) }, count);
+	else
+		mask = CTileMap::SampleSolidMask<true>(sampler, { start.x - (count - 1), start.y }, count);
+	return ReverseBits64(mask) >> (64 - count);
+}
+
+// Merged shadow of wall runs, Bottom < Top
+struct ShadowSpan
+{
+	Slope Bottom;
+	Slope Top;
+};
+
+internal _FORCE_INLINE_ bool
+SlopeLessOrEqual(Slope a, Slope b)
+{
+	return a.y * b.x <= b.y * a.x;
+}
+
+// Spans stay sorted and never overlap or touch, so a tile is hidden if a single span covers it
+internal int
+AddShadow(ShadowSpan* shadows, int count, ShadowSpan shadow)
+{
+	int first = 0;
+	while (first < count && !SlopeLessOrEqual(shadow.Bottom, shadows[first].Top))
+		++first;
+
+	int last = first;
+	while (last < count && SlopeLessOrEqual(shadows[last].Bottom, shadow.Top))
+	{
+		if (SlopeLessOrEqual(shadows[last].Bottom, shadow.Bottom))
+			shadow.Bottom = shadows[last].Bottom;
+		if (SlopeLessOrEqual(shadow.Top, shadows[last].Top))
+			shadow.Top = shadows[last].Top;
+		++last;
+	}
+
+	int removed = last - first;
+	if (removed == 0 && first < count)
+		SMemMove(&shadows[first + 1], &shadows[first], (count - first) * sizeof(ShadowSpan));
+	else if (removed > 1 && last < count)
+		SMemMove(&shadows[first + 1], &shadows[last], (count - last) * sizeof(ShadowSpan));
+	shadows[first] = shadow;
+	return count + 1 - removed;
+}
+
+// Lowest y where y * den >= num, at least 0
+internal _FORCE_INLINE_ int
+CeilDiv(int num, int den)
+{
+	return (num <= 0) ? 0 : (num + den - 1) / den;
+}
+
+// Highest y where y * den <= num, -1 if there is none
+internal _FORCE_INLINE_ int
+FloorDiv(int num, int den)
+{
+	return (num < 0) ? -1 : num / den;
+}
+
+void RowMaskComputeOctant(TileSampler* sampler, Vector2i origin, int radius, uint8_t octant,
+	uint64_t visible[ROW_MASK_FOV_MAX_RADIUS + 1])
+{
+	SASSERT(radius > 0 && radius <= ROW_MASK_FOV_MAX_RADIUS);
+	SASSERT(octant < 8);
+
+	// Every span comes from a visible wall run at least 1 / 2c wide
+	constexpr int maxShadows = (ROW_MASK_FOV_MAX_RADIUS + 1) * 2;
+	ShadowSpan shadows[maxShadows];
+	int shadowCount = 0;
+
+	SMemClear(visible, sizeof(uint64_t) * (ROW_MASK_FOV_MAX_RADIUS + 1));
+
+	int radiusSqr = radius * radius;
+	int rangeY = radius;
+	uint64_t solid = SampleOctantColumn(sampler, origin, octant, 1, 2);
+	for (int c = 1; c <= radius; ++c)
+	{
+		while (rangeY >= 0 && c * c + rangeY * rangeY >= radiusSqr)
+			--rangeY;
+		if (rangeY < 0)
+			break;
+		int maxY = (rangeY < c) ? rangeY : c;
+
+		// Walls are hidden once a shadow covers their diamond (2y +- 1) / 2c,
+		// clear tiles once it covers their inner square (4y - 1) / (4c + 1) to (4y + 1) / (4c - 1)
+		uint64_t wallShadow = 0;
+		uint64_t clearShadow = 0;
+		for (int i = 0; i < shadowCount; ++i)
+		{
+			Slope bottom = shadows[i].Bottom;
+			Slope top = shadows[i].Top;
+			int wallLo = CeilDiv(2 * c * bottom.y + bottom.x, 2 * bottom.x);
+			int wallHi = FloorDiv(2 * c * top.y - top.x, 2 * top.x);
+			int clearLo = CeilDiv((4 * c + 1) * bottom.y + bottom.x, 4 * bottom.x);
+			int clearHi = FloorDiv((4 * c - 1) * top.y - top.x, 4 * top.x);
+			wallShadow |= BitRange(wallLo, wallHi);
+			clearShadow |= BitRange(clearLo, clearHi);
+		}
+
+		uint64_t inRange = BitRange(0, maxY);
+		uint64_t columnVisible = inRange & ((solid & ~wallShadow) | (~solid & ~clearShadow));
+		visible[c] = columnVisible;
+		if (!columnVisible)
+			break;
+
+		int nextCount = (c + 2 < 64) ? c + 2 : 64;
+		uint64_t nextSolid = (c < radius) ? SampleOctantColumn(sampler, origin, octant, c + 1, nextCount) : 0;
+
+		// Each run of visible walls [y0, y1] shadows from the bottom of its lowest diamond,
+		// or the bottom right corner if the tile to its right is a wall, to the top of its highest
+		uint64_t walls = solid & columnVisible;
+		while (walls)
+		{
+			int y0 = LowestBitIndex64(walls);
+			uint64_t run = walls | (walls - 1);
+			int y1 = (~run) ? LowestBitIndex64(~run) - 1 : 63;
+			walls &= ~BitRange(0, y1);
+
+			ShadowSpan shadow;
+			shadow.Bottom = { 2 * y0 - 1, 2 * c + (int)((nextSolid >> y0) & 1) };
+			shadow.Top = { 2 * y1 + 1, 2 * c };
+			SASSERT(shadowCount < maxShadows);
+			shadowCount = AddShadow(shadows, shadowCount, shadow);
+		}
+		solid = nextSolid;
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Core.h"
+#include "Vector2i.h"
+
+struct TileSampler;
+
+// Shadowcasting on the chunk solid bitplanes. An octant column of up to 64 tiles
+// is 1 uint64_t, visibility of a column is a few shifts and masks against the merged
+// wall shadows instead of per tile recursion. Walls are diamonds, clear tiles are
+// visible if their inner square is lit, the same shapes as the Milazzo ComputeOctant()
+// in Lighting.cpp. Sectors are not narrowed tile by tile like it does, so a few tiles
+// around wall corners differ, see TestRowMaskFov() in Lighting.cpp.
+constexpr global_var int ROW_MASK_FOV_MAX_RADIUS = 63;
+
+// Bit y of visible[x] is set if octant tile (x, y) is visible, x in [1, radius].
+// Uses TranslationTable octants, tiles are visible if x * x + y * y < radius * radius.
+void RowMaskComputeOctant(TileSampler* sampler, Vector2i origin, int radius, uint8_t octant,
+	uint64_t visible[ROW_MASK_FOV_MAX_RADIUS + 1]);
@@ -27,6 +27,16 @@ global_var uint64_t GameMemSize;
 global_var uint64_t TemporaryMemSize;
 global_var uint64_t TotalMemoryAllocated;
 global_var uint64_t LastFrameTempMemoryUsage;
+global_var uint64_t MemoryInUse;		// Game and tracked malloc allocations
+global_var uint64_t PeakMemoryInUse;
+
+internal _FORCE_INLINE_ void
+TrackMemoryUsage(uint64_t freed, uint64_t allocated)
+{
+	MemoryInUse = MemoryInUse - freed + allocated;
+	if (MemoryInUse > PeakMemoryInUse)
+		PeakMemoryInUse = MemoryInUse;
+}
 
 internal void* CMemAlloc(size_t n, size_t sz) { return SMemAlloc(n * sz); }
 
@@ -134,6 +144,7 @@ void* SMemAllocTag(uint8_t allocator, size_t size, MemoryTag tag)
 			#if SMEM_USE_TAGS
 			MemoryTagUsage[(uint8_t)tag] += size;
 			#endif
+			TrackMemoryUsage(0, size);
 			memory = SMemAlloc(size);
 		} break;
 
@@ -147,6 +158,7 @@ void* SMemAllocTag(uint8_t allocator, size_t size, MemoryTag tag)
 			#if SMEM_USE_TAGS
 			MemoryTagUsage[(uint8_t)MemoryTag::TrackedMalloc] += size;
 			#endif
+			TrackMemoryUsage(0, size);
 			memory = _aligned_malloc(size, 16);
 		} break;
 
@@ -175,6 +187,7 @@ void* SMemReallocTag(uint8_t allocator, void* ptr, size_t oldSize, size_t newSiz
 			MemoryTagUsage[(uint8_t)tag] -= oldSize;
 			MemoryTagUsage[(uint8_t)tag] += newSize;
 			#endif
+			TrackMemoryUsage(oldSize, newSize);
 			memory = SMemRealloc(ptr, newSize);
 		} break;
 
@@ -191,6 +204,7 @@ void* SMemReallocTag(uint8_t allocator, void* ptr, size_t oldSize, size_t newSiz
 			MemoryTagUsage[(uint8_t)MemoryTag::TrackedMalloc] -= oldSize;
 			MemoryTagUsage[(uint8_t)MemoryTag::TrackedMalloc] += newSize;
 			#endif
+			TrackMemoryUsage(oldSize, newSize);
 			memory = _aligned_realloc(ptr, newSize, 16);
 		} break;
 
@@ -218,6 +232,7 @@ void  SMemFreeTag(uint8_t allocator, void* ptr, size_t size, MemoryTag tag)
 #if SMEM_USE_TAGS
 			MemoryTagUsage[(uint8_t)tag] -= size;
 #endif
+			TrackMemoryUsage(size, 0);
 			SMemFree(ptr);
 		} break;
 
@@ -232,6 +247,7 @@ void  SMemFreeTag(uint8_t allocator, void* ptr, size_t size, MemoryTag tag)
 #if SMEM_USE_TAGS
 			MemoryTagUsage[(uint8_t)MemoryTag::TrackedMalloc] -= size;
 #endif
+			TrackMemoryUsage(size, 0);
 			_aligned_free(ptr);
 		} break;
 
@@ -325,6 +341,11 @@ uint64_t SMemGetAllocated()
 	return TotalMemoryAllocated;
 }
 
+uint64_t SMemGetPeakUsage()
+{
+	return PeakMemoryInUse;
+}
+
 uint64_t SMemGetLastFrameTempUsage()
 {
 	return LastFrameTempMemoryUsage;
@@ -82,6 +82,7 @@ _FORCE_INLINE_ void SMemCopy(void* dst, const void* src, size_t size);
 _FORCE_INLINE_ void SMemMove(void* dst, const void* src, size_t size);
 _FORCE_INLINE_ void SMemSet(void* block, int value, size_t size);
 _FORCE_INLINE_ void SMemClear(void* block, size_t size);
+_FORCE_INLINE_ bool SMemCompare(const void* a, const void* b, size_t size); // true if equal
 
 bool ValidateMemory(SAllocator allocator, void* block);
 bool ValidateGameMemory(void* block);
@@ -89,6 +90,7 @@ bool ValidateTempMemory(void* block);
 
 const size_t* SMemGetTaggedUsages();
 uint64_t SMemGetAllocated();
+uint64_t SMemGetPeakUsage();	// Highest bytes of game and malloc allocations in use
 uint64_t SMemGetLastFrameTempUsage();
 
 #define SMEM_USE_TAGS 1
@@ -142,3 +144,10 @@ void SMemClear(void* dst, size_t size)
 	SASSERT(size > 0);
 	memset(dst, 0, size);
 }
+
+bool SMemCompare(const void* a, const void* b, size_t size)
+{
+	SASSERT(a);
+	SASSERT(b);
+	return memcmp(a, b, size) == 0;
+}
@@ -1,7 +1,17 @@
 #include "SRandom.h"
 
+#include "SMemory.h"
+
 #include <time.h>
 
+#if defined(__AVX2__)
+	#define SRAND_AVX2 1
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SRAND_SSE2 1
+	#include <emmintrin.h>
+#endif
+
 thread_local global_var SRandom GlobalRandom;
 thread_local global_var bool IsInitialized;
 
@@ -212,6 +222,313 @@ void SRandLongJump(SRandom* state)
 	state->Seed3 = s3;
 }
 
+// #####################
+// # Xoroshiro256** x4 #
+// #####################
+
+void SRandLanesInitialize(SRandomLanes* lanes, uint64_t seed)
+{
+	SASSERT(lanes);
+
+	SRandom state;
+	SRandomInitialize(&state, seed);
+	for (int i = 0; i < SRAND_LANES; ++i)
+	{
+		lanes->Seed0[i] = state.Seed0;
+		lanes->Seed1[i] = state.Seed1;
+		lanes->Seed2[i] = state.Seed2;
+		lanes->Seed3[i] = state.Seed3;
+		SRandJump(&state);
+	}
+}
+
+#if SRAND_AVX2
+
+internal _FORCE_INLINE_ __m256i
+RotlLanes(__m256i x, int k)
+{
+	return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+}
+
+// Writes steps * SRAND_LANES values
+internal void
+GenerateSteps(SRandomLanes* lanes, uint64_t* out, size_t steps)
+{
+	__m256i s0 = _mm256_load_si256((const __m256i*)lanes->Seed0);
+	__m256i s1 = _mm256_load_si256((const __m256i*)lanes->Seed1);
+	__m256i s2 = _mm256_load_si256((const __m256i*)lanes->Seed2);
+	__m256i s3 = _mm256_load_si256((const __m256i*)lanes->Seed3);
+
+	for (size_t i = 0; i < steps; ++i)
+	{
+		// rotl(s1 * 5, 7) * 9, multiplies done as shift + add
+		__m256i x5 = _mm256_add_epi64(s1, _mm256_slli_epi64(s1, 2));
+		__m256i r = RotlLanes(x5, 7);
+		__m256i result = _mm256_add_epi64(r, _mm256_slli_epi64(r, 3));
+		_mm256_storeu_si256((__m256i*)(out + i * SRAND_LANES), result);
+
+		__m256i t = _mm256_slli_epi64(s1, 17);
+		s2 = _mm256_xor_si256(s2, s0);
+		s3 = _mm256_xor_si256(s3, s1);
+		s1 = _mm256_xor_si256(s1, s2);
+		s0 = _mm256_xor_si256(s0, s3);
+		s2 = _mm256_xor_si256(s2, t);
+		s3 = RotlLanes(s3, 45);
+	}
+
+	_mm256_store_si256((__m256i*)lanes->Seed0, s0);
+	_mm256_store_si256((__m256i*)lanes->Seed1, s1);
+	_mm256_store_si256((__m256i*)lanes->Seed2, s2);
+	_mm256_store_si256((__m256i*)lanes->Seed3, s3);
+}
+
+#elif SRAND_SSE2
+
+internal _FORCE_INLINE_ __m128i
+RotlLanes(__m128i x, int k)
+{
+	return _mm_or_si128(_mm_slli_epi64(x, k), _mm_srli_epi64(x, 64 - k));
+}
+
+internal _FORCE_INLINE_ __m128i
+StepLanes(__m128i& s0, __m128i& s1, __m128i& s2, __m128i& s3)
+{
+	__m128i x5 = _mm_add_epi64(s1, _mm_slli_epi64(s1, 2));
+	__m128i r = RotlLanes(x5, 7);
+	__m128i result = _mm_add_epi64(r, _mm_slli_epi64(r, 3));
+
+	__m128i t = _mm_slli_epi64(s1, 17);
+	s2 = _mm_xor_si128(s2, s0);
+	s3 = _mm_xor_si128(s3, s1);
+	s1 = _mm_xor_si128(s1, s2);
+	s0 = _mm_xor_si128(s0, s3);
+	s2 = _mm_xor_si128(s2, t);
+	s3 = RotlLanes(s3, 45);
+	return result;
+}
+
+// Writes steps * SRAND_LANES values, lanes 0-1 and 2-3 in separate registers
+internal void
+GenerateSteps(SRandomLanes* lanes, uint64_t* out, size_t steps)
+{
+	static_assert(SRAND_LANES == 4, "SSE2 path steps 2 registers of 2 lanes");
+
+	__m128i a0 = _mm_load_si128((const __m128i*)&lanes->Seed0[0]);
+	__m128i a1 = _mm_load_si128((const __m128i*)&lanes->Seed1[0]);
+	__m128i a2 = _mm_load_si128((const __m128i*)&lanes->Seed2[0]);
+	__m128i a3 = _mm_load_si128((const __m128i*)&lanes->Seed3[0]);
+	__m128i b0 = _mm_load_si128((const __m128i*)&lanes->Seed0[2]);
+	__m128i b1 = _mm_load_si128((const __m128i*)&lanes->Seed1[2]);
+	__m128i b2 = _mm_load_si128((const __m128i*)&lanes->Seed2[2]);
+	__m128i b3 = _mm_load_si128((const __m128i*)&lanes->Seed3[2]);
+
+	for (size_t i = 0; i < steps; ++i)
+	{
+		_mm_storeu_si128((__m128i*)(out + i * SRAND_LANES), StepLanes(a0, a1, a2, a3));
+		_mm_storeu_si128((__m128i*)(out + i * SRAND_LANES + 2), StepLanes(b0, b1, b2, b3));
+	}
+
+	_mm_store_si128((__m128i*)&lanes->Seed0[0], a0);
+	_mm_store_si128((__m128i*)&lanes->Seed1[0], a1);
+	_mm_store_si128((__m128i*)&lanes->Seed2[0], a2);
+	_mm_store_si128((__m128i*)&lanes->Seed3[0], a3);
+	_mm_store_si128((__m128i*)&lanes->Seed0[2], b0);
+	_mm_store_si128((__m128i*)&lanes->Seed1[2], b1);
+	_mm_store_si128((__m128i*)&lanes->Seed2[2], b2);
+	_mm_store_si128((__m128i*)&lanes->Seed3[2], b3);
+}
+
+#else
+
+internal void
+GenerateSteps(SRandomLanes* lanes, uint64_t* out, size_t steps)
+{
+	for (int lane = 0; lane < SRAND_LANES; ++lane)
+	{
+		SRandom state = { lanes->Seed0[lane], lanes->Seed1[lane], lanes->Seed2[lane], lanes->Seed3[lane] };
+		for (size_t i = 0; i < steps; ++i)
+			out[i * SRAND_LANES + lane] = SRandNext(&state);
+
+		lanes->Seed0[lane] = state.Seed0;
+		lanes->Seed1[lane] = state.Seed1;
+		lanes->Seed2[lane] = state.Seed2;
+		lanes->Seed3[lane] = state.Seed3;
+	}
+}
+
+#endif
+
+// Values are generated into a stack buffer and converted from there
+constexpr global_var size_t SRAND_FILL_BUFFER = 64 * SRAND_LANES;
+
+// Calls convert(values, count) with count 64 bit values until valueCount are consumed
+template<typename Convert>
+internal _FORCE_INLINE_ void
+FillBuffered(SRandomLanes* lanes, size_t valueCount, Convert convert)
+{
+	alignas(32) uint64_t buffer[SRAND_FILL_BUFFER];
+	while (valueCount > 0)
+	{
+		size_t count = (valueCount < SRAND_FILL_BUFFER) ? valueCount : SRAND_FILL_BUFFER;
+		size_t steps = (count + SRAND_LANES - 1) / SRAND_LANES;
+		GenerateSteps(lanes, buffer, steps);
+		convert(buffer, count);
+		valueCount -= count;
+	}
+}
+
+void SRandFillU64(SRandomLanes* lanes, uint64_t* out, size_t count)
+{
+	SASSERT(lanes);
+	SASSERT(out || count == 0);
+
+	size_t fullSteps = count / SRAND_LANES;
+	GenerateSteps(lanes, out, fullSteps);
+
+	size_t done = fullSteps * SRAND_LANES;
+	FillBuffered(lanes, count - done, [out, done](const uint64_t* values, size_t n)
+		{
+			SMemCopy(out + done, values, n * sizeof(uint64_t));
+		});
+}
+
+void SRandFillFloats(SRandomLanes* lanes, float* out, size_t count)
+{
+	SASSERT(lanes);
+	SASSERT(out || count == 0);
+
+	size_t pairs = count / 2;
+	float* dst = out;
+	FillBuffered(lanes, pairs, [&dst](const uint64_t* values, size_t n)
+		{
+			for (size_t i = 0; i < n; ++i)
+			{
+				dst[i * 2] = FloatFromBits((uint32_t)values[i]);
+				dst[i * 2 + 1] = FloatFromBits((uint32_t)(values[i] >> 32));
+			}
+			dst += n * 2;
+		});
+
+	if (count & 1)
+	{
+		alignas(32) uint64_t tail[SRAND_LANES];
+		GenerateSteps(lanes, tail, 1);
+		dst[0] = FloatFromBits((uint32_t)tail[0]);
+	}
+}
+
+void SRandFillRange(SRandomLanes* lanes, uint32_t* out, size_t count, uint32_t lower, uint32_t upper)
+{
+	SASSERT(lanes);
+	SASSERT(out || count == 0);
+	if (lower > upper)
+	{
+		SLOG_ERR("[ SRandom ] lower(%u) is > upper(%u)!", lower, upper);
+		SASSERT(false);
+		return;
+	}
+
+	uint64_t range = (uint64_t)upper - lower + 1;
+	uint32_t* dst = out;
+	size_t remaining = count;
+	FillBuffered(lanes, (count + 1) / 2, [&dst, &remaining, range, lower](const uint64_t* values, size_t n)
+		{
+			for (size_t i = 0; i < n; ++i)
+			{
+				uint32_t halves[2] = { (uint32_t)values[i], (uint32_t)(values[i] >> 32) };
+				for (int h = 0; h < 2 && remaining > 0; ++h, --remaining)
+					*dst++ = lower + (uint32_t)(((uint64_t)halves[h] * range) >> 32);
+			}
+		});
+}
+
+void SRandFillBools(SRandomLanes* lanes, bool* out, size_t count)
+{
+	SASSERT(lanes);
+	SASSERT(out || count == 0);
+
+	bool* dst = out;
+	size_t remaining = count;
+	FillBuffered(lanes, (count + 63) / 64, [&dst, &remaining](const uint64_t* values, size_t n)
+		{
+			for (size_t i = 0; i < n; ++i)
+			{
+				size_t bits = (remaining < 64) ? remaining : 64;
+				for (size_t b = 0; b < bits; ++b)
+					dst[b] = (values[i] >> b) & 1;
+				dst += bits;
+				remaining -= bits;
+			}
+		});
+}
+
+int TestRandomLanes()
+{
+	constexpr uint64_t seed = 0xC0FFEE;
+	constexpr size_t count = 1001;
+
+	SRandomLanes lanes;
+	SRandLanesInitialize(&lanes, seed);
+
+	uint64_t values[count];
+	SRandFillU64(&lanes, values, count);
+
+	SRandom scalar[SRAND_LANES];
+	SRandomInitialize(&scalar[0], seed);
+	for (int i = 1; i < SRAND_LANES; ++i)
+	{
+		scalar[i] = scalar[i - 1];
+		SRandJump(&scalar[i]);
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t expected = SRandNext(&scalar[i % SRAND_LANES]);
+		if (values[i] != expected)
+		{
+			SLOG_ERR("[ SRandom ] Lane value %u does not match scalar xoshiro", (uint32_t)i);
+			return 0;
+		}
+	}
+
+	float floats[count];
+	SRandFillFloats(&lanes, floats, count);
+	uint32_t ranged[count];
+	SRandFillRange(&lanes, ranged, count, 10, 13);
+	bool bools[count];
+	SRandFillBools(&lanes, bools, count);
+
+	int rangeCounts[4] = {};
+	int trueCount = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (floats[i] < 0.0f || floats[i] >= 1.0f || ranged[i] < 10 || ranged[i] > 13)
+		{
+			SLOG_ERR("[ SRandom ] Lane fill out of range at %u", (uint32_t)i);
+			return 0;
+		}
+		++rangeCounts[ranged[i] - 10];
+		trueCount += bools[i];
+	}
+
+	for (int i = 0; i < 4; ++i)
+	{
+		if (rangeCounts[i] < 150)
+		{
+			SLOG_ERR("[ SRandom ] Lane range value %d only drawn %d times", i + 10, rangeCounts[i]);
+			return 0;
+		}
+	}
+	if (trueCount < 400 || trueCount > 600)
+	{
+		SLOG_ERR("[ SRandom ] Lane bools drew %d trues out of %u", trueCount, (uint32_t)count);
+		return 0;
+	}
+
+	SLOG_INFO("[ SRandom ] Random lanes match scalar xoshiro");
+	return 1;
+}
+
 
 
 // #######################
@@ -311,3 +628,125 @@ void X128PlusLongJump(X128PlusRandom* state)
 	state->Seed[0] = s0;
 	state->Seed[1] = s1;
 }
+
+// ###########
+// # Squares #
+// ###########
+
+uint64_t SRandCounterKey(uint64_t seed, RandPurpose purpose, uint32_t stream)
+{
+	uint64_t key = SplitMixNext64(seed);
+	key = SplitMixNext64(key ^ ((uint64_t)purpose << 32 | stream));
+	// Squares keys have to be odd
+	return key | 1;
+}
+
+uint32_t SRandCounter32(uint64_t key, uint64_t counter)
+{
+	uint64_t x = counter * key;
+	uint64_t y = x;
+	uint64_t z = y + key;
+	x = x * x + y; x = (x >> 32) | (x << 32);
+	x = x * x + z; x = (x >> 32) | (x << 32);
+	x = x * x + y; x = (x >> 32) | (x << 32);
+	return (uint32_t)((x * x + z) >> 32);
+}
+
+uint64_t SRandCounter64(uint64_t key, uint64_t counter)
+{
+	uint64_t x = counter * key;
+	uint64_t y = x;
+	uint64_t z = y + key;
+	x = x * x + y; x = (x >> 32) | (x << 32);
+	x = x * x + z; x = (x >> 32) | (x << 32);
+	x = x * x + y; x = (x >> 32) | (x << 32);
+	uint64_t t = x = x * x + z; x = (x >> 32) | (x << 32);
+	return t ^ ((x * x + y) >> 32);
+}
+
+float SRandCounterFloat(uint64_t key, uint64_t counter)
+{
+	return FloatFromBits(SRandCounter32(key, counter));
+}
+
+uint64_t SRandCounterRange(uint64_t key, uint64_t counter, uint64_t lower, uint64_t upper)
+{
+	if (lower > upper)
+	{
+		SLOG_ERR("[ SRandom ] lower(%llu) is > upper(%llu)!", (unsigned long long)lower, (unsigned long long)upper);
+		SASSERT(false);
+		return 0;
+	}
+	// upper - lower + 1 wraps to 0
+	if (upper - lower == UINT64_MAX)
+		return SRandCounter64(key, counter);
+	return SRandCounter64(key, counter) % (upper - lower + 1) + lower;
+}
+
+int TestCounterRandom()
+{
+	constexpr int buckets = 16;
+	constexpr int samples = 1 << 16;
+
+	uint64_t key = SRandCounterKey(1234, RandPurpose::Default);
+	if (key != SRandCounterKey(1234, RandPurpose::Default)
+		|| key == SRandCounterKey(1234, RandPurpose::CaveFill)
+		|| key == SRandCounterKey(1234, RandPurpose::Default, 1)
+		|| key == SRandCounterKey(1235, RandPurpose::Default))
+	{
+		SLOG_ERR("[ SRandom ] Counter keys are not unique per seed, purpose and stream");
+		return 0;
+	}
+
+	// Drawing in reverse has to give the same values
+	uint32_t forward[64];
+	for (int i = 0; i < 64; ++i)
+		forward[i] = SRandCounter32(key, SRandTileCounter(i - 32, -i));
+	for (int i = 63; i >= 0; --i)
+	{
+		if (forward[i] != SRandCounter32(key, SRandTileCounter(i - 32, -i)))
+		{
+			SLOG_ERR("[ SRandom ] Counter value changed with draw order");
+			return 0;
+		}
+	}
+
+	int counts[buckets] = {};
+	for (int i = 0; i < samples; ++i)
+	{
+		float value = SRandCounterFloat(key, SRandTileCounter(i & 255, i >> 8));
+		if (value < 0.0f || value >= 1.0f)
+		{
+			SLOG_ERR("[ SRandom ] Counter float %f out of range", value);
+			return 0;
+		}
+		++counts[(int)(value * buckets)];
+
+		uint64_t ranged = SRandCounterRange(key, (uint64_t)i, 3, 5);
+		if (ranged < 3 || ranged > 5)
+		{
+			SLOG_ERR("[ SRandom ] Counter range %u out of range", (uint32_t)ranged);
+			return 0;
+		}
+	}
+
+	if (SRandCounterRange(key, 7, 0, UINT64_MAX) != SRandCounter64(key, 7))
+	{
+		SLOG_ERR("[ SRandom ] Counter full range doesn't match SRandCounter64");
+		return 0;
+	}
+
+	// Loose uniformity check, ~6 standard deviations from 4096 per bucket
+	constexpr int expected = samples / buckets;
+	for (int i = 0; i < buckets; ++i)
+	{
+		if (counts[i] < expected - 400 || counts[i] > expected + 400)
+		{
+			SLOG_ERR("[ SRandom ] Counter values not uniform, bucket %d has %d", i, counts[i]);
+			return 0;
+		}
+	}
+
+	SLOG_INFO("[ SRandom ] Counter based random passed");
+	return 1;
+}
@@ -64,6 +64,45 @@ void SRandJump(SRandom* randomState);
 void SRandLongJump(SRandom* randomState);
 
 
+// #####################
+// # Xoroshiro256** x4 #
+// #####################
+
+constexpr global_var int SRAND_LANES = 4;
+
+/// <summary>
+/// SRAND_LANES xoshiro256** streams stepped together with SIMD (AVX2 if
+/// compiled with it, otherwise SSE2). Lane i starts i SRandJump()s after
+/// lane 0, so lanes never overlap. Output is interleaved, value j comes
+/// from lane j % SRAND_LANES. Fills draw whole steps, values left over
+/// in the last step are dropped.
+/// </summary>
+struct alignas(32) SRandomLanes
+{
+	uint64_t Seed0[SRAND_LANES];
+	uint64_t Seed1[SRAND_LANES];
+	uint64_t Seed2[SRAND_LANES];
+	uint64_t Seed3[SRAND_LANES];
+};
+
+void SRandLanesInitialize(SRandomLanes* lanes, uint64_t seed);
+
+void SRandFillU64(SRandomLanes* lanes, uint64_t* out, size_t count);
+
+/// Values between 0-1, 2 floats per 64 bit value
+void SRandFillFloats(SRandomLanes* lanes, float* out, size_t count);
+
+/// <summary>
+///  lower and upper are inclusive. Maps with a multiply instead of
+///  modulo, 2 values per 64 bit value
+/// </summary>
+void SRandFillRange(SRandomLanes* lanes, uint32_t* out, size_t count, uint32_t lower, uint32_t upper);
+
+/// 64 bools per 64 bit value
+void SRandFillBools(SRandomLanes* lanes, bool* out, size_t count);
+
+int TestRandomLanes();
+
 
 // #################
 // # Xoroshiro128+ #
@@ -95,4 +134,47 @@ void X128PlusJump(X128PlusRandom* state);
    2^96 calls to next(); it can be used to generate 2^32 starting points,
    from each of which jump() will generate 2^32 non-overlapping
    subsequences for parallel distributed computations. */
-void X128PlusLongJump(X128PlusRandom* state);
\ No newline at end of file
+void X128PlusLongJump(X128PlusRandom* state);
+
+
+// ##################
+// # Squares (CBRNG) #
+// ##################
+
+/// <summary>
+/// Counter based generator (Widynski, "Squares: A Fast Counter-Based RNG").
+/// Stateless, a value only depends on the key and counter, so draws don't
+/// depend on which thread makes them or in what order.
+/// Keys come from SRandCounterKey(), counters usually from SRandTileCounter().
+/// </summary>
+enum class RandPurpose : uint32_t
+{
+	Default = 0,
+	CaveFill,
+	LightFlicker,
+
+	MaxPurposes
+};
+
+/// Key for a (seed, purpose) pair, stream separates multiple draws of a purpose
+uint64_t SRandCounterKey(uint64_t seed, RandPurpose purpose, uint32_t stream = 0);
+
+uint32_t SRandCounter32(uint64_t key, uint64_t counter);
+
+uint64_t SRandCounter64(uint64_t key, uint64_t counter);
+
+/// Value between 0-1
+float SRandCounterFloat(uint64_t key, uint64_t counter);
+
+/// <summary>
+///  lower and upper are inclusive
+/// </summary>
+uint64_t SRandCounterRange(uint64_t key, uint64_t counter, uint64_t lower, uint64_t upper);
+
+/// Unique counter for every world tile, the tile's chunk is part of its coord
+_FORCE_INLINE_ uint64_t SRandTileCounter(int tileX, int tileY)
+{
+	return ((uint64_t)(uint32_t)tileY << 32) | (uint64_t)(uint32_t)tileX;
+}
+
+int TestCounterRandom();
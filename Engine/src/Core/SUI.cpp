@@ -241,6 +241,20 @@ DrawDebugPanel(UIState* state)
 			, GetGameApp()->NumOfLightsUpdated, GetNumOfLights());
 		nk_label(ctx, lightStr, NK_TEXT_LEFT);
 
+		nk_label(ctx, TextFormat("LightEngine: %s"
+			, (GetGame()->UseLightTracer) ? "tracer" : "shadowcasting"), NK_TEXT_LEFT);
+
+		const LightRebuildScheduler* scheduler = &GetGame()->LightingState.RebuildScheduler;
+		nk_label(ctx, TextFormat("LightRebuilds(Done/Deferred): %u/%u"
+			, scheduler->Rebuilt, scheduler->Deferred), NK_TEXT_LEFT);
+
+		if (GetGame()->UseLightLod)
+		{
+			const LightLodStats* lod = &GetGame()->LightingState.LodStats;
+			nk_label(ctx, TextFormat("LightLOD(Merged/Static): %u/%u, Cost: %u/%u"
+				, lod->Merged, lod->Downgraded, lod->CostAfter, lod->CostBefore), NK_TEXT_LEFT);
+		}
+
 		const char* xy = TextFormat("Pos: %s", FMT_VEC2(p->TileToWorld()));
 		nk_label(ctx, xy, NK_TEXT_LEFT);
 
@@ -33,15 +33,14 @@ QueryTilesRect(World* world, Vector2i start, Vector2i end)
 	positions.Allocator = SAllocator::Temp;
 	positions.Reserve(size);
 
-	for (int y = start.y; y < end.y; ++y)
-	{
-		for (int x = start.x; x < end.x; ++x)
+	CTileMap::ForEachSpanRect(&world->ChunkedTileMap, start, end, [&positions](const TileSpan& span)
 		{
-			Vector2i coord = { x, y };
-			if (!WorldIsInBounds(world, coord)) continue;
-			positions.Push(&coord);
-		}
-	}
+			for (int i = 0; i < span.Count; ++i)
+			{
+				Vector2i coord = { span.Start.x + i, span.Start.y };
+				positions.Push(&coord);
+			}
+		});
 	return positions;
 }
 
@@ -51,29 +50,19 @@ QueryTilesRadius(World* world, Vector2i center, float radius)
 {
 	SASSERT(radius > 0.0f);
 
-	int startX = center.x - (int)radius;
-	int startY = center.y - (int)radius;
-	int endX = center.x + (int)radius;
-	int endY = center.y + (int)radius;
-	float sqrRadius = radius * radius;
-
-	uint32_t size = (endX - startX) + (endY - startY);
+	uint32_t diameter = (uint32_t)radius * 2 + 1;
 	SList<Vector2i> positions = {};
 	positions.Allocator = SAllocator::Temp;
-	positions.Reserve(size);
+	positions.Reserve(diameter * diameter);
 
-	for (int y = startY; y < endY; ++y)
-	{
-		for (int x = startX; x < endX; ++x)
+	CTileMap::ForEachSpanRadius(&world->ChunkedTileMap, center, radius, [&positions](const TileSpan& span)
 		{
-			Vector2i coord = { x , y };
-			if (!WorldIsInBounds(world, coord)) continue;
-
-			float sqrDist = coord.SqrDistance(center);
-			if (sqrDist < sqrRadius)
+			for (int i = 0; i < span.Count; ++i)
+			{
+				Vector2i coord = { span.Start.x + i, span.Start.y };
 				positions.Push(&coord);
-		}
-	}
+			}
+		});
 	return positions;
 }
 
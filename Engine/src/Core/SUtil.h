@@ -7,6 +7,10 @@
 
 #include "Structures/SList.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 Vector4 Vec4Add(const Vector4& v0, const Vector4& v1);
 
 int IModNegative(int a, int b);
@@ -84,6 +88,31 @@ IsPowerOf2(size_t num)
 	return (num > 0ULL && ((num & (num - 1ULL)) == 0ULL));
 }
 
+// Index of the lowest set bit, num must not be 0
+_FORCE_INLINE_ int
+LowestBitIndex64(uint64_t num)
+{
+	SASSERT(num);
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, num);
+	return (int)index;
+#else
+	return __builtin_ctzll(num);
+#endif
+}
+
+_FORCE_INLINE_ constexpr uint64_t
+ReverseBits64(uint64_t num)
+{
+	num = ((num >> 1) & 0x5555555555555555ull) | ((num & 0x5555555555555555ull) << 1);
+	num = ((num >> 2) & 0x3333333333333333ull) | ((num & 0x3333333333333333ull) << 2);
+	num = ((num >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((num & 0x0F0F0F0F0F0F0F0Full) << 4);
+	num = ((num >> 8) & 0x00FF00FF00FF00FFull) | ((num & 0x00FF00FF00FF00FFull) << 8);
+	num = ((num >> 16) & 0x0000FFFF0000FFFFull) | ((num & 0x0000FFFF0000FFFFull) << 16);
+	return (num >> 32) | (num << 32);
+}
+
 struct World;
 
 
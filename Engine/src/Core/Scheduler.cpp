@@ -13,10 +13,10 @@ void DistributedTileUpdater::Update(ChunkedTileMap* tilemap, TileMapChunk* chunk
 	for (int i = 0; i < updateCount; ++i)
 	{
 		TileData data = chunk->Tiles[Index];
-		OnUpdate onUpdateCB = data.GetTile()->OnUpdateCB;
-		if (onUpdateCB)
+		uint16_t tileId = data.TileId();
+		if (TileMgr.HasUpdate.Get(tileId))
 		{
-			onUpdateCB(Index, data);
+			TileMgr.OnUpdateCBs[tileId](Index, data);
 		}
 
 		Index = (Index + 1) % COUNT;
@@ -24,3 +24,164 @@ void DistributedTileUpdater::Update(ChunkedTileMap* tilemap, TileMapChunk* chunk
 
 	UpdateAccumulator -= (float)updateCount;
 }
+
+int DistributedTileUpdater::CatchUp(ChunkedTileMap* tilemap, TileMapChunk* chunk, double dormantTime)
+{
+	uint64_t totalUpdates = (uint64_t)(dormantTime * (double)UPDATES_PER_SEC);
+	if (totalUpdates == 0)
+		return 0;
+
+	// Every tile gets updated once per sweep, tiles in the
+	// partial sweep starting at Index get 1 more.
+	uint64_t sweeps = totalUpdates / COUNT;
+	uint32_t remainder = (uint32_t)(totalUpdates % COUNT);
+
+	int changed = 0;
+	uint64_t simulatedSweeps = 0;
+	for (uint32_t i = 0; i < COUNT; ++i)
+	{
+		uint32_t offset = (i + COUNT - Index) % COUNT;
+		uint64_t tileUpdates = sweeps + ((offset < remainder) ? 1 : 0);
+		if (tileUpdates == 0)
+			continue;
+
+		TileData* data = &chunk->Tiles[i];
+		uint16_t tileId = data->TileId();
+		OnCatchUp onCatchUp = TileMgr.OnCatchUpCBs[tileId];
+		if (onCatchUp)
+		{
+			TileData before = *data;
+			onCatchUp(i, data, tileUpdates);
+			if (before.TexX != data->TexX || before.TexY != data->TexY || before.HasCeiling != data->HasCeiling)
+				++changed;
+		}
+		else if (TileMgr.HasUpdate.Get(tileId))
+		{
+			uint64_t count = (tileUpdates < MAX_CATCHUP_SWEEPS) ? tileUpdates : MAX_CATCHUP_SWEEPS;
+			if (count > simulatedSweeps)
+				simulatedSweeps = count;
+		}
+	}
+
+	// Tiles without analytic catch up are simulated sweep by sweep,
+	// in the same order the live updater would have.
+	for (uint64_t sweep = 0; sweep < simulatedSweeps; ++sweep)
+	{
+		for (uint32_t n = 0; n < COUNT; ++n)
+		{
+			uint32_t i = (Index + n) % COUNT;
+			uint64_t tileUpdates = sweeps + ((n < remainder) ? 1 : 0);
+			uint64_t count = (tileUpdates < MAX_CATCHUP_SWEEPS) ? tileUpdates : MAX_CATCHUP_SWEEPS;
+			if (sweep >= count)
+				continue;
+
+			TileData data = chunk->Tiles[i];
+			uint16_t tileId = data.TileId();
+			if (!TileMgr.OnCatchUpCBs[tileId] && TileMgr.HasUpdate.Get(tileId))
+			{
+				TileMgr.OnUpdateCBs[tileId](i, data);
+			}
+		}
+	}
+
+	Index = (Index + remainder) % COUNT;
+	return changed;
+}
+
+global_var uint32_t CatchUpTestUpdates[CHUNK_SIZE];
+global_var uint64_t CatchUpTestAnalytic[CHUNK_SIZE];
+global_var TileData CatchUpTestChangeTo;
+
+// Runs the live updater and CatchUp() over dormancies of partial and many sweeps, checking
+// per tile update counts, the MAX_CATCHUP_SWEEPS bound and where the updater resumes
+int TestTileCatchUp()
+{
+	constexpr uint32_t count = DistributedTileUpdater::COUNT;
+	constexpr uint64_t maxSweeps = DistributedTileUpdater::MAX_CATCHUP_SWEEPS;
+
+	uint16_t countedId = TileMgrRegister(DARK_STONE_FLOOR, TileType::Floor);
+	uint16_t analyticId = TileMgrRegister(GOLD_ORE, TileType::Floor);
+	uint16_t plainId = TileMgrRegister(STONE_FLOOR, TileType::Floor);
+	SASSERT(!TileMgr.HasUpdate.Get(plainId) && !TileMgr.OnCatchUpCBs[plainId]);
+
+	OnUpdate previousUpdate = TileMgr.OnUpdateCBs[countedId];
+	OnCatchUp previousCatchUp = TileMgr.OnCatchUpCBs[analyticId];
+	OnUpdate previousAnalyticUpdate = TileMgr.OnUpdateCBs[analyticId];
+	TileMgrSetOnUpdate(countedId, [](uint32_t tileIdx, TileData data)
+		{
+			++CatchUpTestUpdates[tileIdx];
+		});
+	TileMgrSetOnUpdate(analyticId, [](uint32_t tileIdx, TileData data)
+		{
+			++CatchUpTestUpdates[tileIdx];
+		});
+	TileMgrSetOnCatchUp(analyticId, [](uint32_t tileIdx, TileData* data, uint64_t updateCount)
+		{
+			CatchUpTestAnalytic[tileIdx] = updateCount;
+			*data = CatchUpTestChangeTo;
+		});
+	CatchUpTestChangeTo = TileMgrCreate(plainId);
+
+	TileMapChunk* chunk = (TileMapChunk*)SAlloc(SAllocator::Malloc, sizeof(TileMapChunk), MemoryTag::Game);
+
+	int passed = 1;
+	constexpr uint64_t sweepCounts[2] = { 2, 100 };
+	for (uint64_t sweeps : sweepCounts)
+	{
+		// Tiles cycle counted, analytic, plain, counted
+		uint32_t analyticTiles = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint16_t id = (i % 4 == 1) ? analyticId : ((i % 4 == 2) ? plainId : countedId);
+			chunk->Tiles[i] = TileMgrCreate(id);
+			analyticTiles += (id == analyticId);
+		}
+		SMemClear(CatchUpTestUpdates, sizeof(CatchUpTestUpdates));
+		SMemClear(CatchUpTestAnalytic, sizeof(CatchUpTestAnalytic));
+
+		DistributedTileUpdater updater = {};
+		updater.Index = 1000;
+		constexpr uint32_t remainder = 300;
+		uint64_t totalUpdates = sweeps * count + remainder;
+		double dormantTime = ((double)totalUpdates + 0.5) / (double)DistributedTileUpdater::UPDATES_PER_SEC;
+		int changed = updater.CatchUp(nullptr, chunk, dormantTime);
+
+		passed &= changed == (int)analyticTiles;
+		passed &= updater.Index == (int)((1000 + remainder) % count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			// Tiles from the old Index on get the partial sweep
+			uint32_t offset = (i + count - 1000) % count;
+			uint64_t expected = sweeps + ((offset < remainder) ? 1 : 0);
+			if (i % 4 == 1)
+			{
+				passed &= CatchUpTestAnalytic[i] == expected;
+				passed &= CatchUpTestUpdates[i] == 0;
+				passed &= chunk->Tiles[i].TileId() == plainId;
+			}
+			else if (i % 4 == 2)
+				passed &= CatchUpTestUpdates[i] == 0;
+			else
+				passed &= CatchUpTestUpdates[i] == ((expected < maxSweeps) ? expected : maxSweeps);
+		}
+	}
+
+	// The live updater walks from Index and wraps
+	for (uint32_t i = 0; i < count; ++i)
+		chunk->Tiles[i] = TileMgrCreate(countedId);
+	SMemClear(CatchUpTestUpdates, sizeof(CatchUpTestUpdates));
+	DistributedTileUpdater updater = {};
+	updater.Index = count - 10;
+	updater.Update(nullptr, chunk, 20.5f / DistributedTileUpdater::UPDATES_PER_SEC);
+	passed &= updater.Index == 10;
+	passed &= CatchUpTestUpdates[count - 10] == 1 && CatchUpTestUpdates[9] == 1 && CatchUpTestUpdates[10] == 0;
+
+	if (!passed)
+		SLOG_ERR("[ Scheduler ] Tile catch up counts are wrong");
+
+	TileMgrSetOnUpdate(countedId, previousUpdate);
+	TileMgrSetOnUpdate(analyticId, previousAnalyticUpdate);
+	TileMgrSetOnCatchUp(analyticId, previousCatchUp);
+	SFree(SAllocator::Malloc, chunk, sizeof(TileMapChunk), MemoryTag::Game);
+	return passed;
+}
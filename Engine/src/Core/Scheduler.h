@@ -56,9 +56,17 @@ struct DistributedTileUpdater
 	constexpr static int COUNT = CHUNK_SIZE;
 	constexpr static float INTERVAL = 60.0f / 2.0f;
 	constexpr static float UPDATES_PER_SEC = (float)COUNT / INTERVAL;
+	// Max OnUpdate calls per tile when catching up without OnCatchUp
+	constexpr static uint64_t MAX_CATCHUP_SWEEPS = 4;
 
 	int Index;
 	float UpdateAccumulator;
 
 	void Update(ChunkedTileMap* tilemap, TileMapChunk* chunk, float dt);
+
+	// Fast forwards updates the chunk missed while dormant.
+	// Returns number of tiles changed by OnCatchUp callbacks.
+	int CatchUp(ChunkedTileMap* tilemap, TileMapChunk* chunk, double dormantTime);
 };
+
+int TestTileCatchUp();
@@ -104,6 +104,8 @@ struct BitList
 		SizeInBits = Capacity * 64;
 		Memory = (uint64_t*)SRealloc(Allocator, Memory, oldSize, newSize, MemoryTag::Arrays);
 		SASSERT(Memory);
+		if (newSize > oldSize)
+			SMemClear((uint8_t*)Memory + oldSize, newSize - oldSize);
 	}
 
 	void Free()
@@ -141,7 +143,7 @@ struct BitList
 	_FORCE_INLINE_ void SetBit(uint64_t bit)
 	{
 		if (bit >= SizeInBits)
-			Alloc(Allocator, bit);
+			Alloc(Allocator, bit + 1);
 
 		SASSERT(bit < SizeInBits);
 		uint64_t index = bit / 64;
@@ -3,56 +3,123 @@
 #include "Game.h"
 #include "ChunkedTileMap.h"
 #include "Lighting.h"
-#include "Structures/BitArray.h"
 
-struct LightUpdater
-{
-	BitArray<MAX_TILE_COUNT> CheckedTiles;
-	UpdatingLight* Light;
-	Vector3* ColorsArray;
-	ChunkedTileMap* Tilemap;
-	Vector2i Origin;
-	uint32_t Width;
+#include <algorithm>
 
-	void ProcessOctant(uint8_t octant, int x, Slope top, Slope bottom);
-	void SetColor(uint32_t index, float distance);
-};
+constexpr global_var uint32_t LIGHT_ATTENUATION_ONE = 1u << LIGHT_ATTENUATION_SHIFT;
 
-void ProcessLightUpdater(UpdatingLight* light, uint32_t screenLightsWidth, Vector3* colorsArray, ChunkedTileMap* tilemap)
+// Fixed point 1 / (1 + a * d + b * d^2) of every squared distance a light can reach
+global_var uint16_t LightAttenuation[(size_t)LightFalloff::MaxTypes][LIGHT_ATTENUATION_SIZE];
+
+constexpr global_var uint16_t LavaLightAttenuation[9] =
 {
-	LightUpdater updater = LightUpdater();
-	updater.Light = light;
-	updater.ColorsArray = colorsArray;
-	updater.Tilemap = tilemap;
-	updater.Origin = light->Pos;
-	updater.Width = screenLightsWidth;
+	(uint16_t)(0.05f * LIGHT_ATTENUATION_ONE), (uint16_t)(0.15f * LIGHT_ATTENUATION_ONE), (uint16_t)(0.05f * LIGHT_ATTENUATION_ONE),
+	(uint16_t)(0.15f * LIGHT_ATTENUATION_ONE), (uint16_t)(0.25f * LIGHT_ATTENUATION_ONE), (uint16_t)(0.15f * LIGHT_ATTENUATION_ONE),
+	(uint16_t)(0.05f * LIGHT_ATTENUATION_ONE), (uint16_t)(0.15f * LIGHT_ATTENUATION_ONE), (uint16_t)(0.05f * LIGHT_ATTENUATION_ONE),
+};
+// Channel * attenuation * intensity, intensity is at most UINT8_MAX merged lights
+static_assert((uint64_t)LIGHT_ATTENUATION_ONE * UINT8_MAX * UINT8_MAX <= UINT32_MAX, "Color channels are scaled in 32 bits");
 
-	TileCoord coord = WorldTileToCullTile(updater.Origin);
-	uint32_t idx = coord.x + coord.y * updater.Width;
-	updater.SetColor(idx, 0.0f);
-	for (uint8_t octant = 0; octant < 8; ++octant)
+void LightAttenuationInitialize()
+{
+	for (size_t profile = 0; profile < (size_t)LightFalloff::MaxTypes; ++profile)
 	{
-		updater.ProcessOctant(octant, 1, { 1, 1 }, { 0, 1 });
+		float a = LightFalloffProfiles[profile].A;
+		float b = LightFalloffProfiles[profile].B;
+		for (uint32_t distanceSqr = 0; distanceSqr < LIGHT_ATTENUATION_SIZE; ++distanceSqr)
+		{
+			float distance = sqrtf((float)distanceSqr);
+			float attenuation = 1.0f / (1.0f + a * distance + b * (float)distanceSqr);
+			uint32_t value = (uint32_t)(attenuation * (float)LIGHT_ATTENUATION_ONE + 0.5f);
+			LightAttenuation[profile][distanceSqr] = (uint16_t)((value > LIGHT_ATTENUATION_ONE) ? LIGHT_ATTENUATION_ONE : value);
+		}
 	}
 }
 
-void LightUpdater::SetColor(uint32_t index, float distance)
+// dst + color * attenuation, saturating each channel at 255
+internal _FORCE_INLINE_ void
+AddLightColor(Color* dst, Color color, uint32_t attenuation)
 {
-	// https://www.desmos.com/calculator/nmnaud1hrw
-	constexpr float a = 0.0f;
-	constexpr float b = 0.1f;
-	//distance = distance / light.Radius
-	float attenuation = 1.0f / (1.0f + a * distance + b * distance * distance);
-
-	constexpr float inverse = 1.0f / 255.0f;
-	ColorsArray[index].x += (float)Light->Color.r * inverse * attenuation;
-	ColorsArray[index].y += (float)Light->Color.g * inverse * attenuation;
-	ColorsArray[index].z += (float)Light->Color.b * inverse * attenuation;
+	uint32_t r = dst->r + ((color.r * attenuation) >> LIGHT_ATTENUATION_SHIFT);
+	uint32_t g = dst->g + ((color.g * attenuation) >> LIGHT_ATTENUATION_SHIFT);
+	uint32_t b = dst->b + ((color.b * attenuation) >> LIGHT_ATTENUATION_SHIFT);
+	uint32_t a = dst->a + ((color.a * attenuation) >> LIGHT_ATTENUATION_SHIFT);
+	dst->r = (uint8_t)((r > UINT8_MAX) ? UINT8_MAX : r);
+	dst->g = (uint8_t)((g > UINT8_MAX) ? UINT8_MAX : g);
+	dst->b = (uint8_t)((b > UINT8_MAX) ? UINT8_MAX : b);
+	dst->a = (uint8_t)((a > UINT8_MAX) ? UINT8_MAX : a);
 }
 
-void LightUpdater::ProcessOctant(uint8_t octant, int x, Slope top, Slope bottom)
+constexpr global_var int LIGHT_VISITED_DIAMETER = LIGHT_GRID_MAX_RADIUS * 2 + 1;
+constexpr global_var int LIGHT_VISITED_WORDS = (LIGHT_VISITED_DIAMETER * LIGHT_VISITED_DIAMETER + 63) / 64;
+
+// Per worker scratch, a light only clears the (2r+1)^2 bits it uses
+thread_local global_var uint64_t LightVisitedBits[LIGHT_VISITED_WORDS];
+
+// Tiles a light has already reached, in light local coordinates
+struct LightVisited
+{
+	uint64_t* Bits;
+	int Radius;
+	int Diameter;
+};
+
+internal LightVisited
+LightVisitedBegin(int radius)
 {
-	int rangeLimit = (int)Light->Radius;
+	SASSERT(radius >= 0 && radius <= LIGHT_GRID_MAX_RADIUS);
+
+	LightVisited visited;
+	visited.Bits = LightVisitedBits;
+	visited.Radius = radius;
+	visited.Diameter = radius * 2 + 1;
+	int words = (visited.Diameter * visited.Diameter + 63) / 64;
+	SMemClear(visited.Bits, words * sizeof(uint64_t));
+	return visited;
+}
+
+// Returns true the first time an offset is visited
+internal _FORCE_INLINE_ bool
+LightVisitedSet(LightVisited* visited, int x, int y)
+{
+	SASSERT(x >= -visited->Radius && x <= visited->Radius);
+	SASSERT(y >= -visited->Radius && y <= visited->Radius);
+	uint32_t bit = (uint32_t)((x + visited->Radius) + (y + visited->Radius) * visited->Diameter);
+	uint64_t mask = 1ull << (bit & 63);
+	if (visited->Bits[bit >> 6] & mask)
+		return false;
+
+	visited->Bits[bit >> 6] |= mask;
+	return true;
+}
+
+struct LightUpdater
+{
+	LightVisited Visited;
+	TileSampler Sampler;
+	UpdatingLight* Light;
+	Vector3* ColorsArray;
+	Vector2i Origin;
+	Vector2i ViewMin;	// View rect, looked up once instead of per tile
+	Vector2i ViewMax;
+	uint32_t Width;
+};
+
+internal void
+LightUpdaterSetColor(LightUpdater* updater, uint32_t index, int distanceSqr)
+{
+	constexpr float inverse = 1.0f / ((float)LIGHT_ATTENUATION_ONE * 255.0f);
+	float attenuation = (float)LightAttenuation[(uint8_t)updater->Light->Falloff][distanceSqr] * inverse;
+	updater->ColorsArray[index].x += (float)updater->Light->Color.r * attenuation;
+	updater->ColorsArray[index].y += (float)updater->Light->Color.g * attenuation;
+	updater->ColorsArray[index].z += (float)updater->Light->Color.b * attenuation;
+}
+
+template<int Octant>
+internal void
+LightUpdaterProcessOctant(LightUpdater* updater, int x, Slope top, Slope bottom)
+{
+	int rangeLimit = (int)updater->Light->Radius;
 	for (; x <= rangeLimit; ++x) // rangeLimit < 0 || x <= rangeLimit
 	{
 		// compute the Y coordinates where the top vector leaves the column (on the right) and where the bottom vector
@@ -64,29 +131,25 @@ void LightUpdater::ProcessOctant(uint8_t octant, int x, Slope top, Slope bottom)
 		int wasOpaque = -1; // 0:false, 1:true, -1:not applicable
 		for (int y = topY; y >= bottomY; --y)
 		{
-			Vector2i txty = Origin;
-			txty.x += x * TranslationTable[octant][0] + y * TranslationTable[octant][1];
-			txty.y += x * TranslationTable[octant][2] + y * TranslationTable[octant][3];
-
-			float distance;
-			bool inRange = TileInsideCullRect(txty)
-				&& CTileMap::IsTileInBounds(Tilemap, txty)
-				&& ((distance = Vector2i{ x, y }.Distance({})) <= rangeLimit);
+			Vector2i offset = OctantTransform<Octant>(x, y);
+			Vector2i txty = { updater->Origin.x + offset.x, updater->Origin.y + offset.y };
+
+			bool inRange = txty.x >= updater->ViewMin.x && txty.y >= updater->ViewMin.y
+				&& txty.x < updater->ViewMax.x && txty.y < updater->ViewMax.y
+				&& x * x + y * y <= rangeLimit * rangeLimit;
 			if (inRange)
 			{
-				TileCoord coord = WorldTileToCullTile(txty);
-				int index = coord.x + coord.y * GetGameApp()->View.ResolutionInTiles.x;
-				if (!CheckedTiles.Get(index))
+				if (LightVisitedSet(&updater->Visited, offset.x, offset.y))
 				{
-					CheckedTiles.Set(index);
-					SetColor(index, distance);
+					uint32_t index = (txty.x - updater->ViewMin.x) + (txty.y - updater->ViewMin.y) * updater->Width;
+					LightUpdaterSetColor(updater, index, x * x + y * y);
 				}
 			}
 
 			// NOTE: use the next line instead if you want the algorithm to be symmetrical
 			// if(inRange && (y != topY || top.Y*x >= top.X*y) && (y != bottomY || bottom.Y*x <= bottom.X*y)) SetVisible(tx, ty);
 
-			bool isOpaque = !inRange || CTileMap::BlocksLight(Tilemap, txty);
+			bool isOpaque = !inRange || CTileMap::SampleBlocksLight(&updater->Sampler, txty);
 			if (x != rangeLimit)
 			{
 				if (isOpaque)
@@ -95,7 +158,7 @@ void LightUpdater::ProcessOctant(uint8_t octant, int x, Slope top, Slope bottom)
 					{                  // adjust the bottom vector upwards and continue processing it in the next column.
 						Slope newBottom = { y * 2 + 1, x * 2 - 1 }; // (x*2-1, y*2+1) is a vector to the top-left of the opaque tile
 						if (!inRange || y == bottomY) { bottom = newBottom; break; } // don't recurse unless we have to
-						else ProcessOctant(octant, x + 1, top, newBottom);
+						else LightUpdaterProcessOctant<Octant>(updater, x + 1, top, newBottom);
 					}
 					wasOpaque = 1;
 				}
@@ -110,51 +173,60 @@ void LightUpdater::ProcessOctant(uint8_t octant, int x, Slope top, Slope bottom)
 	}
 }
 
-_FORCE_INLINE_ internal
-Color Clamp0255(Color c0, Color c1, float attenuation)
-{
-	Color res;
+typedef void(*LightUpdaterKernel)(LightUpdater* updater, int x, Slope top, Slope bottom);
 
-	float r = ((float)c0.r + ((float)c1.r * attenuation));
-	float g = ((float)c0.g + ((float)c1.g * attenuation));
-	float b = ((float)c0.b + ((float)c1.b * attenuation));
-	float a = ((float)c0.a + ((float)c1.a * attenuation));
+constexpr global_var LightUpdaterKernel LightUpdaterKernels[8] =
+{
+	LightUpdaterProcessOctant<0>, LightUpdaterProcessOctant<1>, LightUpdaterProcessOctant<2>, LightUpdaterProcessOctant<3>,
+	LightUpdaterProcessOctant<4>, LightUpdaterProcessOctant<5>, LightUpdaterProcessOctant<6>, LightUpdaterProcessOctant<7>,
+};
 
-	res.r = (r > 255.0f) ? UINT8_MAX : (uint8_t)r;
-	res.g = (g > 255.0f) ? UINT8_MAX : (uint8_t)g;
-	res.b = (b > 255.0f) ? UINT8_MAX : (uint8_t)b;
-	res.a = (a > 255.0f) ? UINT8_MAX : (uint8_t)a;
+void ProcessLightUpdater(UpdatingLight* light, uint32_t screenLightsWidth, Vector3* colorsArray, ChunkedTileMap* tilemap)
+{
+	LightUpdater updater;
+	updater.Visited = LightVisitedBegin((int)light->Radius);
+	updater.Sampler = CTileMap::CreateTileSampler(tilemap);
+	updater.Light = light;
+	updater.ColorsArray = colorsArray;
+	updater.Origin = light->Pos;
+	updater.ViewMin = GetGameApp()->View.ScreenXYInTiles;
+	updater.ViewMax = updater.ViewMin.Add(GetGameApp()->View.ResolutionInTiles);
+	updater.Width = screenLightsWidth;
+	LightVisitedSet(&updater.Visited, 0, 0);
 
-	return res;
+	TileCoord coord = WorldTileToCullTile(updater.Origin);
+	uint32_t idx = coord.x + coord.y * updater.Width;
+	LightUpdaterSetColor(&updater, idx, 0);
+	for (uint8_t octant = 0; octant < 8; ++octant)
+	{
+		LightUpdaterKernels[octant](&updater, 1, { 1, 1 }, { 0, 1 });
+	}
 }
 
-struct ThreadedUpdater
+struct CacheBuilder
 {
-	Light* Light;
-	Color* ColorsArray;
-	ChunkedTileMap* Tilemap;
-	uint32_t Width;
-	BitArray<MAX_TILE_COUNT> CheckedTiles;
+	LightVisibilityCache* Cache;
+	TileSampler Sampler;
+	LightVisited Visited;
 };
 
 internal void
-SetColor(Color* colorsArray, uint32_t index, Color color, float distance)
+AddCacheTile(CacheBuilder* builder, int x, int y, int distanceSqr)
 {
-	// https://www.desmos.com/calculator/nmnaud1hrw
-	constexpr float a = 0.0f;
-	constexpr float b = 0.1f;
-	//distance = distance / light.Radius
-	float attenuation = 1.0f / (1.0f + a * distance + b * distance * distance);
-
-	constexpr float inverse = 1.0f / 255.0f;
+	LightVisibilityCache* cache = builder->Cache;
+	if (!LightVisitedSet(&builder->Visited, x, y))
+		return;
 
-	colorsArray[index] = Clamp0255(colorsArray[index], color, attenuation);
+	SASSERT(cache->Count < cache->Capacity);
+	cache->Tiles[cache->Count++] = { (int16_t)x, (int16_t)y, (uint16_t)distanceSqr };
 }
 
+template<int Octant>
 internal void
-ProcessOctants(ThreadedUpdater* updater, uint8_t octant, int x, Slope top, Slope bottom)
+CacheBuilderProcessOctant(CacheBuilder* builder, int x, Slope top, Slope bottom)
 {
-	int rangeLimit = (int)updater->Light->Radius;
+	const LightVisibilityCache* cache = builder->Cache;
+	int rangeLimit = cache->Radius;
 	for (; x <= rangeLimit; ++x) // rangeLimit < 0 || x <= rangeLimit
 	{
 		// compute the Y coordinates where the top vector leaves the column (on the right) and where the bottom vector
@@ -166,29 +238,18 @@ ProcessOctants(ThreadedUpdater* updater, uint8_t octant, int x, Slope top, Slope
 		int wasOpaque = -1; // 0:false, 1:true, -1:not applicable
 		for (int y = topY; y >= bottomY; --y)
 		{
-			Vector2i txty = updater->Light->Pos;
-			txty.x += x * TranslationTable[octant][0] + y * TranslationTable[octant][1];
-			txty.y += x * TranslationTable[octant][2] + y * TranslationTable[octant][3];
-
-			float distance;
-			bool inRange = TileInsideCullRect(txty)
-				&& CTileMap::IsTileInBounds(updater->Tilemap, txty)
-				&& ((distance = Vector2i{ x, y }.Distance({})) <= rangeLimit);
+			Vector2i offset = OctantTransform<Octant>(x, y);
+			Vector2i txty = { cache->Pos.x + offset.x, cache->Pos.y + offset.y };
+
+			int distanceSqr = x * x + y * y;
+			bool inRange = distanceSqr <= rangeLimit * rangeLimit;
 			if (inRange)
-			{
-				TileCoord coord = WorldTileToCullTile(txty);
-				int index = coord.x + coord.y * GetGameApp()->View.ResolutionInTiles.x;
-				if (!updater->CheckedTiles.Get(index))
-				{
-					updater->CheckedTiles.Set(index);
-					SetColor(updater->ColorsArray, index, updater->Light->Color, distance);
-				}
-			}
+				AddCacheTile(builder, offset.x, offset.y, distanceSqr);
 
 			// NOTE: use the next line instead if you want the algorithm to be symmetrical
 			// if(inRange && (y != topY || top.Y*x >= top.X*y) && (y != bottomY || bottom.Y*x <= bottom.X*y)) SetVisible(tx, ty);
 
-			bool isOpaque = !inRange || CTileMap::BlocksLight(updater->Tilemap, txty);
+			bool isOpaque = !inRange || CTileMap::SampleBlocksLight(&builder->Sampler, txty);
 			if (x != rangeLimit)
 			{
 				if (isOpaque)
@@ -197,7 +258,7 @@ ProcessOctants(ThreadedUpdater* updater, uint8_t octant, int x, Slope top, Slope
 					{                  // adjust the bottom vector upwards and continue processing it in the next column.
 						Slope newBottom = { y * 2 + 1, x * 2 - 1 }; // (x*2-1, y*2+1) is a vector to the top-left of the opaque tile
 						if (!inRange || y == bottomY) { bottom = newBottom; break; } // don't recurse unless we have to
-						else ProcessOctants(updater, octant, x + 1, top, newBottom);
+						else CacheBuilderProcessOctant<Octant>(builder, x + 1, top, newBottom);
 					}
 					wasOpaque = 1;
 				}
@@ -212,12 +273,74 @@ ProcessOctants(ThreadedUpdater* updater, uint8_t octant, int x, Slope top, Slope
 	}
 }
 
-void
-UpdateStaticLight(StaticLight* light, Color* threadColorsArray, size_t width)
+typedef void(*CacheBuilderKernel)(CacheBuilder* builder, int x, Slope top, Slope bottom);
+
+constexpr global_var CacheBuilderKernel CacheBuilderKernels[8] =
 {
-	SASSERT(light);
-	SASSERT(threadColorsArray);
-	SASSERT(width > 0);
+	CacheBuilderProcessOctant<0>, CacheBuilderProcessOctant<1>, CacheBuilderProcessOctant<2>, CacheBuilderProcessOctant<3>,
+	CacheBuilderProcessOctant<4>, CacheBuilderProcessOctant<5>, CacheBuilderProcessOctant<6>, CacheBuilderProcessOctant<7>,
+};
+
+// Shadowcasts at MaxIntensity, ignoring the cull rect, so the result
+// is only tied to the light's position and the tiles around it
+internal void
+RebuildVisibilityCache(UpdatingLight* light, ChunkedTileMap* tilemap)
+{
+	LightVisibilityCache* cache = &light->Cache;
+	SASSERT(cache->Tiles);
+
+	CacheBuilder builder;
+	builder.Cache = cache;
+	builder.Sampler = CTileMap::CreateTileSampler(tilemap);
+	builder.Visited = LightVisitedBegin(cache->Radius);
+
+	cache->Pos = light->Pos;
+	cache->Count = 0;
+
+	AddCacheTile(&builder, 0, 0, 0);
+	for (uint8_t octant = 0; octant < 8; ++octant)
+	{
+		CacheBuilderKernels[octant](&builder, 1, { 1, 1 }, { 0, 1 });
+	}
+
+	std::sort(cache->Tiles, cache->Tiles + cache->Count, [](const LightCacheTile& a, const LightCacheTile& b)
+		{
+			return a.DistanceSqr < b.DistanceSqr;
+		});
+	cache->IsValid = true;
+}
+
+// intensity scales the light, merged lights are drawn as their sum
+internal void
+ApplyVisibilityCache(UpdatingLight* light, Color* colorsArray, uint32_t width, uint32_t intensity)
+{
+	SASSERT(intensity > 0 && intensity <= UINT8_MAX);
+	const LightVisibilityCache* cache = &light->Cache;
+	const uint16_t* attenuation = LightAttenuation[(uint8_t)light->Falloff];
+	int rangeLimit = (int)light->Radius;
+	uint32_t rangeLimitSqr = (uint32_t)(rangeLimit * rangeLimit);
+	Vector2i viewMin = GetGameApp()->View.ScreenXYInTiles;
+	Vector2i viewMax = viewMin.Add(GetGameApp()->View.ResolutionInTiles);
+	for (uint32_t i = 0; i < cache->Count; ++i)
+	{
+		const LightCacheTile* tile = &cache->Tiles[i];
+		if (tile->DistanceSqr > rangeLimitSqr)
+			break;
+
+		int x = cache->Pos.x + tile->x;
+		int y = cache->Pos.y + tile->y;
+		if (x < viewMin.x || y < viewMin.y || x >= viewMax.x || y >= viewMax.y)
+			continue;
+
+		uint32_t idx = (uint32_t)(x - viewMin.x) + (uint32_t)(y - viewMin.y) * width;
+		AddLightColor(&colorsArray[idx], light->Color, attenuation[tile->DistanceSqr] * intensity);
+	}
+}
+
+internal void
+ApplyStaticKernel(const Light* light, Color* colorsArray, size_t width, uint32_t intensity)
+{
+	SASSERT(intensity > 0 && intensity <= UINT8_MAX);
 	Vector2i cullPos = WorldTileToCullTile(light->Pos);
 	for (int i = 0; i < 9; ++i)
 	{
@@ -226,20 +349,24 @@ UpdateStaticLight(StaticLight* light, Color* threadColorsArray, size_t width)
 		{
 			size_t idx = (size_t)pos.x + (size_t)pos.y * width;
 			SASSERT(idx < GetGameApp()->View.TotalTilesOnScreen);
-			threadColorsArray[idx] = Clamp0255(threadColorsArray[idx], light->Color, LavaLightWeights[i]);
+			AddLightColor(&colorsArray[idx], light->Color, LavaLightAttenuation[i] * intensity);
 		}
 	}
 }
 
-void 
-ThreadedLightUpdate(Light* light, Color* threadColorsArray, ChunkedTileMap* tilemap, uint32_t lightsScreenWidth)
+void
+UpdateStaticLight(StaticLight* light, Color* threadColorsArray, size_t width)
 {
-	ThreadedUpdater updater = {};
-	updater.Light = light;
-	updater.ColorsArray = threadColorsArray;
-	updater.Tilemap = tilemap;
-	updater.Width = lightsScreenWidth;
+	SASSERT(light);
+	SASSERT(threadColorsArray);
+	SASSERT(width > 0);
+	ApplyStaticKernel(light, threadColorsArray, width, 1);
+}
 
+void 
+ThreadedLightUpdate(const VisibleLight* visible, Color* threadColorsArray, ChunkedTileMap* tilemap, uint32_t lightsScreenWidth)
+{
+	Light* light = visible->Light;
 	switch (light->LightType)
 	{
 		case (LightType::Updating): // Updating light
@@ -247,21 +374,235 @@ ThreadedLightUpdate(Light* light, Color* threadColorsArray, ChunkedTileMap* tile
 			SASSERT(light->UpdateFunc);
 			light->UpdateFunc(light, GetGame(), GetDeltaTime());
 
-			TileCoord coord = WorldTileToCullTile(light->Pos);
-			uint32_t idx = coord.x + coord.y * updater.Width;
-			SetColor(updater.ColorsArray, idx, light->Color, 0.0f);
-			for (uint8_t octant = 0; octant < 8; ++octant)
+			UpdatingLight* updatingLight = (UpdatingLight*)light;
+			if (visible->UseStaticKernel)
 			{
-				ProcessOctants(&updater, octant, 1, { 1, 1 }, { 0, 1 });
+				ApplyStaticKernel(light, threadColorsArray, lightsScreenWidth, visible->Intensity);
+				break;
 			}
+
+			if (visible->Rebuild)
+				RebuildVisibilityCache(updatingLight, tilemap);
+			ApplyVisibilityCache(updatingLight, threadColorsArray, lightsScreenWidth, visible->Intensity);
 		} break;
 
 		case (LightType::Static): // Static light
 		{
-			UpdateStaticLight((StaticLight*)updater.Light, updater.ColorsArray, updater.Width);
+			UpdateStaticLight((StaticLight*)light, threadColorsArray, lightsScreenWidth);
 		} break;
 
 		default:
 			break;
 	}
-}
\ No newline at end of file
+}
+
+// Runtime TranslationTable and per tile chunk lookups, what the kernels replaced
+internal void
+ReferenceProcessOctant(CacheBuilder* builder, ChunkedTileMap* tilemap, uint8_t octant, int x, Slope top, Slope bottom)
+{
+	const LightVisibilityCache* cache = builder->Cache;
+	int rangeLimit = cache->Radius;
+	for (; x <= rangeLimit; ++x)
+	{
+		int topY = top.x == 1 ? x : ((x * 2 + 1) * top.y + top.x - 1) / (top.x * 2);
+		int bottomY = bottom.y == 0 ? 0 : ((x * 2 - 1) * bottom.y + bottom.x) / (bottom.x * 2);
+
+		int wasOpaque = -1;
+		for (int y = topY; y >= bottomY; --y)
+		{
+			int offsetX = x * TranslationTable[octant][0] + y * TranslationTable[octant][1];
+			int offsetY = x * TranslationTable[octant][2] + y * TranslationTable[octant][3];
+			Vector2i txty = { cache->Pos.x + offsetX, cache->Pos.y + offsetY };
+
+			int distanceSqr = x * x + y * y;
+			bool inRange = distanceSqr <= rangeLimit * rangeLimit;
+			if (inRange)
+				AddCacheTile(builder, offsetX, offsetY, distanceSqr);
+
+			bool isOpaque = !inRange || CTileMap::BlocksLight(tilemap, txty);
+			if (x != rangeLimit)
+			{
+				if (isOpaque)
+				{
+					if (wasOpaque == 0)
+					{
+						Slope newBottom = { y * 2 + 1, x * 2 - 1 };
+						if (!inRange || y == bottomY) { bottom = newBottom; break; }
+						else ReferenceProcessOctant(builder, tilemap, octant, x + 1, top, newBottom);
+					}
+					wasOpaque = 1;
+				}
+				else
+				{
+					if (wasOpaque > 0) top = { y * 2 + 1, x * 2 + 1 };
+					wasOpaque = 0;
+				}
+			}
+		}
+		if (wasOpaque != 0) break;
+	}
+}
+
+internal void
+ReferenceVisibilityCache(LightVisibilityCache* cache, Vector2i pos, ChunkedTileMap* tilemap)
+{
+	CacheBuilder builder;
+	builder.Cache = cache;
+	builder.Sampler = CTileMap::CreateTileSampler(tilemap);
+	builder.Visited = LightVisitedBegin(cache->Radius);
+
+	cache->Pos = pos;
+	cache->Count = 0;
+
+	AddCacheTile(&builder, 0, 0, 0);
+	for (uint8_t octant = 0; octant < 8; ++octant)
+	{
+		ReferenceProcessOctant(&builder, tilemap, octant, 1, { 1, 1 }, { 0, 1 });
+	}
+}
+
+int TestShadowcastKernels()
+{
+	constexpr int chunksWide = 3;
+	constexpr int radius = 12;
+	constexpr int lightCount = 2048;
+
+	// TileMgrInitialize() registers these the same way
+	TileData wall = TileMgrCreate(TileMgrRegister(ROCKY_WALL, TileType::Solid));
+	TileData floor = TileMgrCreate(TileMgrRegister(STONE_FLOOR, TileType::Floor));
+
+	ChunkedTileMap tilemap = {};
+	CTileMap::Initialize(&tilemap);
+
+	SRandom random;
+	SRandomInitialize(&random, 1337);
+
+	size_t chunksSize = chunksWide * chunksWide * sizeof(TileMapChunk);
+	TileMapChunk* chunks = (TileMapChunk*)SAlloc(SAllocator::Malloc, chunksSize, MemoryTag::Game);
+	SMemClear(chunks, chunksSize);
+	for (int i = 0; i < chunksWide * chunksWide; ++i)
+	{
+		TileMapChunk* chunk = &chunks[i];
+		chunk->ChunkCoord = { i % chunksWide, i / chunksWide };
+		chunk->StartTile = { chunk->ChunkCoord.x * CHUNK_DIMENSIONS, chunk->ChunkCoord.y * CHUNK_DIMENSIONS };
+		chunk->State = ChunkState::Loaded;
+		for (int t = 0; t < CHUNK_SIZE; ++t)
+			chunk->Tiles[t] = (SRandNextRange(&random, 0, 99) < 15) ? wall : floor;
+
+		tilemap.Chunks.Insert(&chunk->ChunkCoord, &chunk);
+	}
+
+	Vector2i* positions = (Vector2i*)SAlloc(SAllocator::Temp, lightCount * sizeof(Vector2i), MemoryTag::Game);
+	int worldSize = chunksWide * CHUNK_DIMENSIONS;
+	for (int i = 0; i < lightCount; ++i)
+	{
+		positions[i].x = (int)SRandNextRange(&random, 0, worldSize - 1);
+		positions[i].y = (int)SRandNextRange(&random, 0, worldSize - 1);
+	}
+
+	UpdatingLight light = {};
+	light.MaxIntensity = (float)radius;
+	light.Cache.Radius = radius;
+	light.Cache.Capacity = (radius * 2 + 1) * (radius * 2 + 1);
+	light.Cache.Tiles = (LightCacheTile*)SAlloc(SAllocator::Temp, light.Cache.Capacity * sizeof(LightCacheTile), MemoryTag::Game);
+
+	LightVisibilityCache reference = light.Cache;
+	reference.Tiles = (LightCacheTile*)SAlloc(SAllocator::Temp, reference.Capacity * sizeof(LightCacheTile), MemoryTag::Game);
+
+	int passed = 1;
+	uint64_t kernelTiles = 0;
+	uint64_t referenceTiles = 0;
+	double kernelTime = 0.0;
+	double referenceTime = 0.0;
+	for (int i = 0; i < lightCount; ++i)
+	{
+		light.Pos = positions[i];
+
+		double start = GetTime();
+		RebuildVisibilityCache(&light, &tilemap);
+		kernelTime += GetTime() - start;
+
+		start = GetTime();
+		ReferenceVisibilityCache(&reference, positions[i], &tilemap);
+		std::sort(reference.Tiles, reference.Tiles + reference.Count, [](const LightCacheTile& a, const LightCacheTile& b)
+			{
+				return a.DistanceSqr < b.DistanceSqr;
+			});
+		referenceTime += GetTime() - start;
+
+		kernelTiles += light.Cache.Count;
+		referenceTiles += reference.Count;
+
+		// Equal distances can sort either way, compare as sets
+		auto byPosition = [](const LightCacheTile& a, const LightCacheTile& b)
+		{
+			return (a.y != b.y) ? a.y < b.y : a.x < b.x;
+		};
+		std::sort(light.Cache.Tiles, light.Cache.Tiles + light.Cache.Count, byPosition);
+		std::sort(reference.Tiles, reference.Tiles + reference.Count, byPosition);
+		if (light.Cache.Count != reference.Count
+			|| memcmp(light.Cache.Tiles, reference.Tiles, reference.Count * sizeof(LightCacheTile)) != 0)
+		{
+			SLOG_ERR("[ Lights ] Kernel visibility mismatch at %s: %u, %u tiles",
+				FMT_VEC2I(positions[i]), light.Cache.Count, reference.Count);
+			passed = 0;
+			break;
+		}
+	}
+
+	SLOG_INFO("[ Lights ] %d lights, radius %d: octant kernels %.3fms, runtime table %.3fms (%.2fx), %llu tiles",
+		lightCount, radius, kernelTime * 1000.0, referenceTime * 1000.0,
+		(kernelTime > 0.0) ? referenceTime / kernelTime : 0.0, (unsigned long long)kernelTiles);
+
+	CTileMap::Free(&tilemap);
+	SFree(SAllocator::Malloc, chunks, chunksSize, MemoryTag::Game);
+	return passed && kernelTiles == referenceTiles;
+}
+
+int TestLightAttenuation()
+{
+	LightAttenuationInitialize();
+
+	constexpr Color colors[] = { { 255, 255, 255, 255 }, { 255, 160, 40, 255 }, { 7, 64, 199, 128 }, { 1, 2, 3, 4 } };
+	constexpr Color bases[] = { { 0, 0, 0, 0 }, { 20, 40, 80, 255 }, { 250, 128, 3, 200 } };
+
+	int passed = 1;
+	int maxDiff = 0;
+	for (size_t profile = 0; profile < (size_t)LightFalloff::MaxTypes; ++profile)
+	{
+		float a = LightFalloffProfiles[profile].A;
+		float b = LightFalloffProfiles[profile].B;
+		for (int distanceSqr = 0; distanceSqr < LIGHT_ATTENUATION_SIZE; ++distanceSqr)
+		{
+			// The float path this replaced
+			float distance = sqrtf((float)distanceSqr);
+			float attenuation = 1.0f / (1.0f + a * distance + b * distance * distance);
+			for (Color color : colors)
+			{
+				for (Color base : bases)
+				{
+					Color result = base;
+					AddLightColor(&result, color, LightAttenuation[profile][distanceSqr]);
+
+					const uint8_t* channels = &color.r;
+					const uint8_t* baseChannels = &base.r;
+					const uint8_t* resultChannels = &result.r;
+					for (int c = 0; c < 4; ++c)
+					{
+						float expected = (float)baseChannels[c] + (float)channels[c] * attenuation;
+						expected = (expected > 255.0f) ? 255.0f : expected;
+						int diff = abs((int)resultChannels[c] - (int)expected);
+						maxDiff = (diff > maxDiff) ? diff : maxDiff;
+					}
+				}
+			}
+		}
+	}
+
+	if (maxDiff > 1)
+	{
+		SLOG_ERR("[ Lights ] Attenuation tables differ from the float falloff by %d", maxDiff);
+		passed = 0;
+	}
+	return passed;
+}
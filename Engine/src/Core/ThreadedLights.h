@@ -5,6 +5,7 @@
 struct Light;
 struct UpdatingLight;
 struct StaticLight;
+struct VisibleLight;
 struct Vector3;
 struct ChunkedTileMap;
 
@@ -12,7 +13,13 @@ void
 ProcessLightUpdater(UpdatingLight* light, uint32_t screenLightsWidth, Vector3* colorsArray, ChunkedTileMap* tilemap);
 
 void 
-ThreadedLightUpdate(Light* light, Color* threadColorsArray, ChunkedTileMap* tilemap, uint32_t LightsScreenWidth);
+ThreadedLightUpdate(const VisibleLight* visible, Color* threadColorsArray, ChunkedTileMap* tilemap, uint32_t LightsScreenWidth);
 
 void
-UpdateStaticLight(StaticLight* light, Color* threadColorsArray, size_t width);
\ No newline at end of file
+UpdateStaticLight(StaticLight* light, Color* threadColorsArray, size_t width);
+
+// Fills the fixed point attenuation tables of every LightFalloff
+void LightAttenuationInitialize();
+
+int TestShadowcastKernels();
+int TestLightAttenuation();
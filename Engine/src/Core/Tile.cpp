@@ -3,7 +3,7 @@
 #include "Game.h"
 #include "Lighting.h"
 
-global_var struct TileMgr TileMgr;
+struct TileMgr TileMgr;
 
 bool TileMgrInitialize(const Texture2D* tilesheetTexture)
 {
@@ -22,11 +22,15 @@ bool TileMgrInitialize(const Texture2D* tilesheetTexture)
 	TileMgrRegister(ROCKY_WALL, TileType::Solid);
 
 	uint16_t lava0 = TileMgrRegister(LAVA_0, TileType::Floor);
-	TileMgr.Tiles[lava0].EmitsLight = true;
-	TileMgr.Tiles[lava0].OnUpdateCB = [](uint32_t tileIdx, TileData data)
+	TileMgrSetEmitsLight(lava0, true);
+	TileMgrSetOnUpdate(lava0, [](uint32_t tileIdx, TileData data)
 	{
 		//SLOG_INFO("Updating tile at %s, id = %u", FMT_VEC2I(pos), TileMgrToTileId(data.AsCoord()));
-	};
+	});
+	// Updates don't change lava, skip simulating them after dormancy
+	TileMgrSetOnCatchUp(lava0, [](uint32_t tileIdx, TileData* data, uint64_t updateCount)
+	{
+	});
 
 	return true;
 }
@@ -36,7 +40,16 @@ struct TileMgr* GetTileMgr() { return &TileMgr; }
 uint16_t TileMgrRegister(TileSheetCoord coord, TileType type)
 {
 	uint16_t result = TileMgrRegister(coord);
-	TileMgr.Tiles[result].Type = type;
+	TileMgr.Types[result] = type;
+	if (type == TileType::Solid)
+		TileMgr.IsSolid.Set(result);
+	else
+		TileMgr.IsSolid.Clear(result);
+
+	if (type == TileType::Floor)
+		TileMgr.IsFloor.Set(result);
+	else
+		TileMgr.IsFloor.Clear(result);
 	return result;
 }
 
@@ -45,33 +58,53 @@ uint16_t TileMgrRegister(TileSheetCoord coord)
 	SASSERT(coord.x < TILE_SHEET_WIDTH_TILES);
 	SASSERT(coord.y < TILE_SHEET_HEIGHT_TILES);
 
-	uint16_t tileId = coord.x;
-	tileId |= ((uint16_t)coord.y << 8);
+	uint16_t tileId = TileMgrToTileId(coord);
+	TileMgr.IsUsed.Set(tileId);
 
-	TileMgr.Tiles[tileId].IsUsed = true;
+	// Types default to Solid(0)
+	if (TileMgr.Types[tileId] == TileType::Solid)
+		TileMgr.IsSolid.Set(tileId);
 
 	return tileId;
 }
 
+void TileMgrSetEmitsLight(uint16_t tileId, bool emitsLight)
+{
+	SASSERT(TileMgr.IsUsed.Get(tileId));
+	if (emitsLight)
+		TileMgr.EmitsLight.Set(tileId);
+	else
+		TileMgr.EmitsLight.Clear(tileId);
+}
+
+void TileMgrSetOnUpdate(uint16_t tileId, OnUpdate onUpdate)
+{
+	SASSERT(TileMgr.IsUsed.Get(tileId));
+	TileMgr.OnUpdateCBs[tileId] = onUpdate;
+	if (onUpdate)
+		TileMgr.HasUpdate.Set(tileId);
+	else
+		TileMgr.HasUpdate.Clear(tileId);
+}
+
+void TileMgrSetOnCatchUp(uint16_t tileId, OnCatchUp onCatchUp)
+{
+	SASSERT(TileMgr.IsUsed.Get(tileId));
+	TileMgr.OnCatchUpCBs[tileId] = onCatchUp;
+}
+
 TileData TileMgrCreate(uint16_t tileId)
 {
-	SASSERT(TileMgr.Tiles[tileId].IsUsed);
+	SASSERT(TileMgr.IsUsed.Get(tileId));
 
-	uint8_t x = (uint8_t)tileId;
-	uint8_t y = (uint8_t)(tileId >> 8);
-	SASSERT(x < TILE_SHEET_WIDTH_TILES);
-	SASSERT(y < TILE_SHEET_HEIGHT_TILES);
+	TileSheetCoord coord = TileMgrGetXY(tileId);
+	SASSERT(coord.x < TILE_SHEET_WIDTH_TILES);
+	SASSERT(coord.y < TILE_SHEET_HEIGHT_TILES);
 
 	TileData tile;
-	tile.TexX = x;
-	tile.TexY = y;
+	tile.TexX = coord.x;
+	tile.TexY = coord.y;
 	tile.HasCeiling = false;
 	tile.Ununsed = 0;
 	return tile;
 }
-
-Tile* TileData::GetTile() const
-{
-	uint16_t id = TileMgrToTileId(AsCoord());
-	return &TileMgr.Tiles[id];
-}
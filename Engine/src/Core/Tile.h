@@ -3,6 +3,8 @@
 #include "Core.h"
 #include "Vector2i.h"
 
+#include "Structures/BitArray.h"
+
 struct TileData;
 
 enum class TileType : uint8_t
@@ -34,28 +36,38 @@ struct TileSheetCoord
 typedef void (*OnUpdate)(uint32_t, TileData);
 typedef void (*OnStepOn)(Vector2i, void* entity);
 typedef void (*OnStepOff)(Vector2i, void* entity);
-
-struct Tile
-{
-	bool IsUsed;
-	bool EmitsLight;
-	TileType Type;
-
-	OnUpdate OnUpdateCB;
-	OnStepOn OnStepOnCB;
-	OnStepOff OnStepOff;
-};
+// Applies updateCount updates at once to a tile in a chunk returning from
+// dormancy. Tiles without one are caught up by calling OnUpdate.
+typedef void (*OnCatchUp)(uint32_t, TileData*, uint64_t updateCount);
 
 #define TILE_SHEET_WIDTH 512
 #define TILE_SHEET_HEIGHT 960
 #define TILE_SHEET_WIDTH_TILES (TILE_SHEET_WIDTH / 16)
 #define TILE_SHEET_HEIGHT_TILES (TILE_SHEET_HEIGHT / 16)
+#define TILE_MAX_IDS (TILE_SHEET_WIDTH_TILES * TILE_SHEET_HEIGHT_TILES)
+
+// Tile properties as a struct of arrays indexed by tile id.
+// Hot properties are bitsets, callbacks are kept in their own arrays.
 struct TileMgr
 {
 	Texture2D TileTextureRef;
-	Tile Tiles[TILE_SHEET_WIDTH_TILES * TILE_SHEET_HEIGHT_TILES];
+
+	BitArray<TILE_MAX_IDS> IsUsed;
+	BitArray<TILE_MAX_IDS> EmitsLight;
+	BitArray<TILE_MAX_IDS> IsSolid;		// TileType::Solid
+	BitArray<TILE_MAX_IDS> IsFloor;		// TileType::Floor
+	BitArray<TILE_MAX_IDS> HasUpdate;	// OnUpdateCBs[id] != nullptr
+
+	TileType Types[TILE_MAX_IDS];
+
+	OnUpdate OnUpdateCBs[TILE_MAX_IDS];
+	OnStepOn OnStepOnCBs[TILE_MAX_IDS];
+	OnStepOff OnStepOffCBs[TILE_MAX_IDS];
+	OnCatchUp OnCatchUpCBs[TILE_MAX_IDS];
 };
 
+extern struct TileMgr TileMgr;
+
 struct TileTexValues
 {
 	uint8_t x;
@@ -72,32 +84,38 @@ struct TileData
 	uint8_t Ununsed;
 
 	inline constexpr TileSheetCoord AsCoord() const { return { TexX, TexY }; }
+	inline constexpr uint16_t TileId() const { return (uint16_t)(TexX + TexY * TILE_SHEET_WIDTH_TILES); }
 
-	Tile* GetTile() const;
+	_FORCE_INLINE_ bool EmitsLight() const { return TileMgr.EmitsLight.Get(TileId()); }
+	_FORCE_INLINE_ bool IsSolid() const { return TileMgr.IsSolid.Get(TileId()); }
+	_FORCE_INLINE_ bool IsFloor() const { return TileMgr.IsFloor.Get(TileId()); }
+	_FORCE_INLINE_ TileType Type() const { return TileMgr.Types[TileId()]; }
 };
 
 bool TileMgrInitialize(const Texture2D* tilesheetTexture);
 
 uint16_t TileMgrRegister(TileSheetCoord coord, TileType type);
 uint16_t TileMgrRegister(TileSheetCoord coord);
+void TileMgrSetEmitsLight(uint16_t tileId, bool emitsLight);
+void TileMgrSetOnUpdate(uint16_t tileId, OnUpdate onUpdate);
+void TileMgrSetOnCatchUp(uint16_t tileId, OnCatchUp onCatchUp);
 
 struct TileMgr* GetTileMgr();
 
 TileData TileMgrCreate(uint16_t tileId);
 
+// Dense id, index into TileMgr arrays
 inline constexpr uint16_t TileMgrToTileId(TileSheetCoord coord)
 {
-	uint16_t id = coord.x;
-	id |= ((uint16_t)coord.y << 8);
-	return id;
+	return (uint16_t)(coord.x + coord.y * TILE_SHEET_WIDTH_TILES);
 }
 
 inline constexpr TileSheetCoord TileMgrGetXY(uint16_t tileId)
 {
 	TileSheetCoord res = 
 	{
-		(uint8_t)tileId,
-		(uint8_t)(tileId >> 8)
+		(uint8_t)(tileId % TILE_SHEET_WIDTH_TILES),
+		(uint8_t)(tileId / TILE_SHEET_WIDTH_TILES)
 	};
 	return res;
 }
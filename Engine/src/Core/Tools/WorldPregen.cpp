@@ -0,0 +1,188 @@
+#include <chrono>
+
+#include "WorldPregen.h"
+
+#include "Core/Game.h"
+#include "Core/SMemory.h"
+#include "Core/ChunkFile.h"
+#include "Core/World.h"
+#include "Core/MapGeneration/MapGeneration.h"
+#include "Core/MapGeneration/NoiseBatch.h"
+#include "Core/WickedEngine/Jobs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WORLD_PREGEN_BATCH_CHUNKS 512 // Chunks generated before writing, 8mb of tiles
+#define WORLD_PREGEN_MAX_RADIUS 32767 // Keeps the chunk count in a uint32_t
+
+struct WorldPregenSettings
+{
+	const char* OutputPath;
+	int Seed;
+	int Radius;
+	int BenchChunks;	// 0 generates the world
+	uint32_t MaxThreads;
+};
+
+// Outlives WorldPregenMain(), job system threads are joined at exit
+global_var GameApplication PregenApp;
+
+// raylib's GetTime() needs a window
+internal double
+GetPregenTime()
+{
+	using namespace std::chrono;
+	return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+internal bool
+ParseArgs(int argc, char** argv, WorldPregenSettings* settings)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			SLOG_ERR("[ WorldGen ] Missing value for %s", arg);
+			return false;
+		}
+
+		if (strcmp(arg, "-seed") == 0)
+			settings->Seed = atoi(value);
+		else if (strcmp(arg, "-radius") == 0)
+			settings->Radius = atoi(value);
+		else if (strcmp(arg, "-threads") == 0)
+			settings->MaxThreads = (uint32_t)atoi(value);
+		else if (strcmp(arg, "-out") == 0)
+			settings->OutputPath = value;
+		else if (strcmp(arg, "-bench") == 0)
+		{
+			settings->BenchChunks = atoi(value);
+			if (settings->BenchChunks <= 0)
+			{
+				SLOG_ERR("[ WorldGen ] Bench chunk count %s must be positive", value);
+				return false;
+			}
+		}
+		else
+		{
+			SLOG_ERR("[ WorldGen ] Unknown argument %s", arg);
+			return false;
+		}
+		++i;
+	}
+
+	if (settings->Radius < 0 || settings->Radius > WORLD_PREGEN_MAX_RADIUS || settings->Radius >= CHUNK_COORD_LIMIT)
+	{
+		SLOG_ERR("[ WorldGen ] Radius %d is out of range", settings->Radius);
+		return false;
+	}
+	return true;
+}
+
+SAPI int WorldPregenMain(int argc, char** argv)
+{
+	WorldPregenSettings settings = {};
+	settings.OutputPath = WORLD_PREGEN_FILE;
+	settings.Seed = 0;
+	settings.Radius = 16;
+	settings.BenchChunks = 0;
+	settings.MaxThreads = ~0u;
+	if (!ParseArgs(argc, argv, &settings))
+	{
+		SLOG_INFO("Usage: WorldGen [-seed N] [-radius N] [-threads N] [-out %s] [-bench N]", WORLD_PREGEN_FILE);
+		return 1;
+	}
+
+	if (settings.BenchChunks > 0)
+	{
+		SMemInitialize(&PregenApp, Megabytes(16), Megabytes(8));
+		MapGenerator generator = {};
+		MapGenInitialize(&generator, settings.Seed);
+		MapGenBenchmark(&generator, settings.BenchChunks);
+		MapGenFree(&generator);
+		SMemShutdown(&PregenApp);
+		return 0;
+	}
+
+	double startTime = GetPregenTime();
+
+	SMemInitialize(&PregenApp, Megabytes(16), Megabytes(8));
+	wi::jobsystem::Initialize(settings.MaxThreads);
+
+	int side = settings.Radius * 2 + 1;
+	uint32_t chunkCount = (uint32_t)side * (uint32_t)side;
+	size_t coordsSize = WORLD_PREGEN_BATCH_CHUNKS * sizeof(ChunkCoord);
+	size_t tilesSize = (size_t)WORLD_PREGEN_BATCH_CHUNKS * CHUNK_SIZE * sizeof(TileData);
+
+	// Generated and written a batch at a time, peak memory doesn't grow with the radius
+	ChunkCoord* coords = (ChunkCoord*)SAlloc(SAllocator::Malloc, coordsSize, MemoryTag::Game);
+	TileData* tiles = (TileData*)SAlloc(SAllocator::Malloc, tilesSize, MemoryTag::Game);
+	SASSERT(coords);
+	SASSERT(tiles);
+
+	MapGenerator generator = {};
+	MapGenInitialize(&generator, settings.Seed);
+
+	ChunkFileWriter writer = {};
+	bool written = ChunkFileBeginWrite(&writer, settings.OutputPath, settings.Seed, chunkCount);
+
+	double prewarmTime = 0.0;
+	double generateTime = 0.0;
+	double writeTime = 0.0;
+	for (uint32_t first = 0; written && first < chunkCount; first += WORLD_PREGEN_BATCH_CHUNKS)
+	{
+		uint32_t batchCount = chunkCount - first;
+		batchCount = (batchCount < WORLD_PREGEN_BATCH_CHUNKS) ? batchCount : WORLD_PREGEN_BATCH_CHUNKS;
+		for (uint32_t i = 0; i < batchCount; ++i)
+		{
+			uint32_t index = first + i;
+			coords[i].x = (int)(index % (uint32_t)side) - settings.Radius;
+			coords[i].y = (int)(index / (uint32_t)side) - settings.Radius;
+		}
+
+		// Climate regions are inserted into a hashmap, fill it before going wide.
+		// A batch covers whole rows between its first and last chunk.
+		double start = GetPregenTime();
+		ChunkCoord regionMin = { -settings.Radius, coords[0].y };
+		ChunkCoord regionMax = { settings.Radius, coords[batchCount - 1].y };
+		MapGenPrewarmRegions(&generator, regionMin, regionMax);
+		prewarmTime += GetPregenTime() - start;
+
+		start = GetPregenTime();
+		wi::jobsystem::context ctx;
+		wi::jobsystem::Dispatch(ctx, batchCount, 4, [&generator, coords, tiles](wi::jobsystem::JobArgs args)
+			{
+				MapGenGenerateTiles(&generator, coords[args.jobIndex], tiles + (size_t)args.jobIndex * CHUNK_SIZE);
+			});
+		wi::jobsystem::Wait(ctx);
+		generateTime += GetPregenTime() - start;
+
+		start = GetPregenTime();
+		written = ChunkFileWriteBatch(&writer, coords, tiles, batchCount);
+		writeTime += GetPregenTime() - start;
+	}
+	written = ChunkFileEndWrite(&writer) && written;
+
+	double totalTime = GetPregenTime() - startTime;
+
+	MemorySizeData fileSize = FindMemSize(sizeof(ChunkFileHeader)
+		+ (size_t)chunkCount * (sizeof(ChunkCoord) + CHUNK_SIZE * sizeof(TileData)));
+	MemorySizeData peakMemory = FindMemSize(SMemGetPeakUsage());
+	SLOG_INFO("[ WorldGen ] Seed %d, radius %d, %u chunks, %u threads, noise %s",
+		settings.Seed, settings.Radius, chunkCount, wi::jobsystem::GetThreadCount() + 1, NoiseInstructionSet());
+	SLOG_INFO("[ WorldGen ] Prewarm %u climate regions: %.3fs", generator.ClimateRegions.Size, prewarmTime);
+	SLOG_INFO("[ WorldGen ] Generate: %.3fs, %.0f chunks/s", generateTime, (double)chunkCount / generateTime);
+	SLOG_INFO("[ WorldGen ] Write %s (%.2f%c): %.3fs", settings.OutputPath, fileSize.Size, fileSize.BytePrefix, writeTime);
+	SLOG_INFO("[ WorldGen ] Total: %.3fs, %.0f chunks/s. Peak memory: %.2f%c",
+		totalTime, (double)chunkCount / totalTime, peakMemory.Size, peakMemory.BytePrefix);
+
+	MapGenFree(&generator);
+	SFree(SAllocator::Malloc, tiles, tilesSize, MemoryTag::Game);
+	SFree(SAllocator::Malloc, coords, coordsSize, MemoryTag::Game);
+	SMemShutdown(&PregenApp);
+
+	return (written) ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Core/Core.h"
+
+// Headless world pregeneration, runs without a window.
+// Usage: WorldGen [-seed N] [-radius N] [-threads N] [-out path] [-bench N]
+// Generates every chunk within radius (in chunks) of the origin on the
+// job system and writes them to a chunk file in batches. -bench instead logs
+// MapGenBenchmark() over N chunks. Returns a process exit code.
+SAPI int WorldPregenMain(int argc, char** argv);
@@ -16,8 +16,12 @@ void WorldInitialize(World* world, GameApplication* gameApp)
 void WorldLoad(World* world, Game* game)
 {
 
+	int seed = 0;
+	if (FileExists(WORLD_PREGEN_FILE) && ChunkFileOpen(&world->ChunkedTileMap, WORLD_PREGEN_FILE))
+		seed = world->ChunkedTileMap.PregenFile.Seed;
+
 	// FIXME: find better location for this
-	MapGenInitialize(&game->MapGen, 0);
+	MapGenInitialize(&game->MapGen, seed);
 
 	CTileMap::Load(&world->ChunkedTileMap);
 
@@ -36,6 +40,7 @@ void WorldFree(World* world)
 	world->IsLoaded = false;
 	world->IsAllocated = false;
 	CTileMap::Free(&world->ChunkedTileMap);
+	MapGenFree(&GetGame()->MapGen);
 	world->EntityActionsList.Free();
 }
 
@@ -59,12 +64,12 @@ bool CanMoveToTile(World* world, Vector2i position)
 		return false;
 
 	TileData* tile = CTileMap::GetTile(&world->ChunkedTileMap, position);
-	return tile->GetTile()->Type == TileType::Floor;
+	return tile && tile->IsFloor();
 }
 
 bool WorldIsInBounds(World* world, Vector2i pos)
 {
-	return CTileMap::IsTileInBounds(&world->ChunkedTileMap, pos);
+	return CTileMap::IsTileInBounds(pos);
 }
 
 void TurnEnd(World* world, Game* game, int timeChange)
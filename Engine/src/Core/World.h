@@ -5,6 +5,9 @@
 
 #include "Structures/SList.h"
 
+// Written by the WorldGen tool, used instead of generating chunks when present
+#define WORLD_PREGEN_FILE "world.schunks"
+
 struct GameApplication;
 struct Game;
 struct Resources;
@@ -0,0 +1,6 @@
+#include <Core/Tools/WorldPregen.h>
+
+int main(int argc, char** argv)
+{
+	return WorldPregenMain(argc, argv);
+}
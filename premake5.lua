@@ -30,13 +30,15 @@ newoption
 include "Engine/vendor/raylib_premake5.lua"
 include "Engine"
 include "Game"
+include "WorldGen"
 
 local directories = {
     "./",
     "Engine/",
     "Engine/vendor/",
     "Game/",
-    "Game/vendor/"
+    "Game/vendor/",
+    "WorldGen/"
 }
 
 local function DeleteVSFiles(path)